@@ -4,7 +4,35 @@
 using namespace std;
 
 void printHelp(){
-    cout << "Usage: ./lite [--help] [--quiet]" << endl;
+    cout << "Usage: ./lite [--help] [--quiet] [--profile] [--cache-limit <bytes>[K|M|G]] [--memory-limit <bytes>[K|M|G]] [--adaptive]" << endl;
+}
+
+//parses a byte count with an optional K, M or G suffix
+bool parseSize(const string& text, size_t& bytes){
+    // stoull accepts a minus sign, after any leading spaces, and wraps it around to a huge count
+    if(text.find('-') != string::npos){
+        return false;
+    }
+    size_t pos = 0;
+    unsigned long long value;
+    try{
+        value = stoull(text, &pos);
+    } catch (...){
+        return false;
+    }
+
+    string suffix = text.substr(pos);
+    if(suffix == "K" || suffix == "k"){
+        value <<= 10;
+    } else if(suffix == "M" || suffix == "m"){
+        value <<= 20;
+    } else if(suffix == "G" || suffix == "g"){
+        value <<= 30;
+    } else if(!suffix.empty()){
+        return false;
+    }
+    bytes = static_cast<size_t>(value);
+    return true;
 }
 
 int main(int argc, char* argv[]){
@@ -13,23 +41,45 @@ int main(int argc, char* argv[]){
     cout << std::boolalpha;
 
     bool quiet = false;
+    bool profile = false;
+    size_t cacheLimit = SQLlite::DEFAULT_CACHE_LIMIT;
+    size_t memoryLimit = 0;
+    bool adaptive = false;
     int opt;
     static struct option long_options[] = {
         {"help", no_argument, 0, 'h'},
         {"quiet", no_argument, 0, 'q'},
+        {"profile", no_argument, 0, 'p'},
+        {"cache-limit", required_argument, 0, 'c'},
+        {"memory-limit", required_argument, 0, 'm'},
+        {"adaptive", no_argument, 0, 'a'},
         {nullptr, 0, nullptr, 0}
     };
 
-    while((opt = getopt_long(argc, argv, "hq", long_options, nullptr)) != -1){
+    while((opt = getopt_long(argc, argv, "hqpc:m:a", long_options, nullptr)) != -1){
         if(opt == 'h'){
             printHelp();
             return 0;
         } else if (opt == 'q'){
             quiet = true;
+        } else if (opt == 'p'){
+            profile = true;
+        } else if (opt == 'c'){
+            if(!parseSize(optarg, cacheLimit)){
+                cout << "Invalid cache limit '" << optarg << "'" << endl;
+                return 1;
+            }
+        } else if (opt == 'm'){
+            if(!parseSize(optarg, memoryLimit)){
+                cout << "Invalid memory limit '" << optarg << "'" << endl;
+                return 1;
+            }
+        } else if (opt == 'a'){
+            adaptive = true;
         }
     }
 
-    SQLlite db(quiet);
+    SQLlite db(quiet, profile, cacheLimit, memoryLimit, adaptive);
     string command;
     do {
         if(cin.fail()){
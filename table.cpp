@@ -2,6 +2,10 @@
 #include <sstream>
 #include <algorithm>
 #include <variant>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <limits>
 
 using namespace std;
 
@@ -23,11 +27,36 @@ void SQLlite::processCommand(const string& cmd){
 
     if(cmd[0] == '#'){
         return;
-    } else if(cmd == "QUIT"){
+    }
+
+    current = ExecStats();
+    auto start = chrono::steady_clock::now();
+    executeCached(cmd, tokens);
+    uint64_t micros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    recordCommand(cmd, micros);
+
+    if(profile){
+        cout << "Profile: " << cmd << " took " << micros << " us, scanned " << current.rowsScanned << " rows, returned " << current.rowsReturned << " rows";
+        if(!current.accessPath.empty()){
+            cout << " via " << current.accessPath;
+        }
+        if(current.bytesSpilled > 0){
+            cout << ", spilled " << current.bytesSpilled << " bytes to disk";
+        }
+        cout << endl;
+    }
+}
+
+void SQLlite::executeCommand(const string& cmd, const vector<string>& tokens){
+    if(cmd == "QUIT"){
         cout << "Thanks for using!" << endl;
         return;
     } else if (cmd == "CREATE"){
-        createTable(tokens);
+        if(tokens.size() >= 3 && tokens[0] == "VIEW" && tokens[2] == "AS"){
+            createView(tokens);
+        } else {
+            createTable(tokens);
+        }
     } else if(cmd == "REMOVE"){
         if(tokens.empty()){
             cout << "Error during REMOVE: Missing table name" << endl;
@@ -46,6 +75,10 @@ void SQLlite::processCommand(const string& cmd){
             //PRINT FROM <tableName> <numCols> <col1> <col2> ... WHERE <colname> <op> <value>
             string tableName = tokens[1];
             auto tableIt = tables.find(tableName);
+            if(tableIt == tables.end() && views.count(tableName) > 0){
+                printView(tableName);
+                return;
+            }
             if(tableIt == tables.end()){
                 cout << "Error during PRINT: " << tableName << " does not name a table in the database" << endl;
                 return;
@@ -83,7 +116,7 @@ void SQLlite::processCommand(const string& cmd){
 
                 int colIndex = static_cast<int>(distance(tableIt->second.columnNames.begin(), colIt));
                 Field value = parseValue(valueStr, tableIt->second.columnTypes[colIndex]);
-                tableIt->second.printWhere(selectedColumns, whereCol, op, value, quiet, tableName);
+                tableIt->second.printWhere(selectedColumns, whereCol, op, value, quiet, adaptive, tableName, current);
             } else {
                 printTable(vector<string>(tokens.begin() + 1, tokens.end()), quiet);
             }
@@ -108,19 +141,315 @@ void SQLlite::processCommand(const string& cmd){
             }
 
             tableIt->second.generateIndex(colName, indexType, tableName);
+            bumpVersion(tableIt->second);
         }
     } else if (cmd == "JOIN"){
         joinTables(tokens);
+    } else if (cmd == "STATS"){
+        printStats();
+    } else if (cmd == "COMPRESSION"){ // COMPRESSION <tablename>
+        printCompression(tokens);
     } else {
         cout << "Error: unrecognized command" << endl;
     }
 }
 
+//serve PRINT and JOIN from the result cache while the tables they read are unchanged
+void SQLlite::executeCached(const string& cmd, const vector<string>& tokens){
+    vector<string> readTables;
+    if(cmd == "PRINT" && tokens.size() >= 2 && tokens[0] == "FROM"){
+        readTables = {tokens[1]};
+    } else if(cmd == "JOIN" && tokens.size() >= 3){
+        readTables = {tokens[0], tokens[2]};
+    }
+
+    CacheEntry entry;
+    for(const string& tableName : readTables){
+        auto it = tables.find(tableName);
+        if(it == tables.end()){
+            break;
+        }
+        entry.dependencies.emplace_back(tableName, it->second.version);
+    }
+
+    if(cache.capacity == 0 || readTables.empty() || entry.dependencies.size() != readTables.size()){
+        executeCommand(cmd, tokens);
+        return;
+    }
+
+    string key = cmd;
+    for(const string& token : tokens){
+        key += " " + token;
+    }
+
+    CacheEntry* cached = cache.find(key);
+    if(cached != nullptr){
+        if(cached->dependencies == entry.dependencies){
+            ++cache.hits;
+            current.accessPath = "result cache";
+            cout << cached->output << flush;
+            return;
+        }
+        cache.erase(key);
+    }
+    ++cache.misses;
+
+    {
+        OutputCapture capture(cout, cache.capacity);
+        executeCommand(cmd, tokens);
+        if(capture.overflowed()){
+            return;
+        }
+        entry.output = capture.captured();
+    }
+    cache.insert(key, move(entry));
+}
+
+SQLlite::CacheEntry* SQLlite::ResultCache::find(const string& key){
+    auto it = entries.find(key);
+    if(it == entries.end()){
+        return nullptr;
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    return &it->second->second;
+}
+
+void SQLlite::ResultCache::insert(const string& key, CacheEntry entry){
+    size_t size = entrySize(key, entry);
+    if(size > capacity){
+        return;
+    }
+    erase(key);
+
+    while(bytesUsed + size > capacity && !lru.empty()){
+        erase(lru.back().first);
+        ++evictions;
+    }
+
+    lru.emplace_front(key, move(entry));
+    entries[key] = lru.begin();
+    bytesUsed += size;
+}
+
+void SQLlite::ResultCache::erase(const string& key){
+    auto it = entries.find(key);
+    if(it == entries.end()){
+        return;
+    }
+    bytesUsed -= entrySize(key, it->second->second);
+    lru.erase(it->second);
+    entries.erase(it);
+}
+
+size_t SQLlite::ResultCache::entrySize(const string& key, const CacheEntry& entry){
+    size_t bytes = sizeof(CacheEntry) + 2 * key.size() + entry.output.size();
+    for(const auto& [tableName, version] : entry.dependencies){
+        bytes += sizeof(pair<string, uint64_t>) + tableName.size();
+    }
+    return bytes;
+}
+
+int SQLlite::OutputCapture::overflow(int ch){
+    if(ch == traits_type::eof()){
+        return traits_type::not_eof(ch);
+    }
+    if(!truncated){
+        if(text.size() < maxBytes){
+            text.push_back(static_cast<char>(ch));
+        } else {
+            truncated = true;
+            string().swap(text);
+        }
+    }
+    return target->sputc(static_cast<char>(ch));
+}
+
+streamsize SQLlite::OutputCapture::xsputn(const char* s, streamsize n){
+    if(!truncated){
+        if(text.size() + n <= maxBytes){
+            text.append(s, n);
+        } else {
+            truncated = true;
+            string().swap(text);
+        }
+    }
+    return target->sputn(s, n);
+}
+
+void SQLlite::CommandStats::record(uint64_t micros){
+    ++count;
+    totalMicros += micros;
+    maxMicros = max(maxMicros, micros);
+
+    size_t bucket = 0;
+    while(bucket + 1 < NUM_BUCKETS && (uint64_t(1) << bucket) <= micros){
+        ++bucket;
+    }
+    ++histogram[bucket];
+}
+
+//upper bound of the bucket holding the p-th fraction of calls
+uint64_t SQLlite::CommandStats::percentile(double p) const{
+    uint64_t target = static_cast<uint64_t>(p * count + 0.5);
+    uint64_t seen = 0;
+    for(size_t bucket = 0; bucket < NUM_BUCKETS; ++bucket){
+        seen += histogram[bucket];
+        if(seen >= target && seen > 0){
+            return uint64_t(1) << bucket;
+        }
+    }
+    return uint64_t(1) << (NUM_BUCKETS - 1);
+}
+
+void SQLlite::recordCommand(const string& cmd, uint64_t micros){
+    static const vector<string> knownCommands = {"CREATE", "REMOVE", "INSERT", "PRINT", "DELETE", "GENERATE", "JOIN", "STATS", "COMPRESSION", "QUIT"};
+    bool known = find(knownCommands.begin(), knownCommands.end(), cmd) != knownCommands.end();
+
+    stats.commands[known ? cmd : "OTHER"].record(micros);
+    stats.rowsScanned += current.rowsScanned;
+    stats.rowsReturned += current.rowsReturned;
+    stats.hashHits += current.hashHits;
+    stats.hashMisses += current.hashMisses;
+    stats.bstHits += current.bstHits;
+    stats.bstMisses += current.bstMisses;
+    stats.bitmapHits += current.bitmapHits;
+    stats.fullScans += current.fullScans;
+    stats.blocksSkipped += current.blocksSkipped;
+    stats.compressedBlocks += current.compressedBlocks;
+    stats.bytesSpilled += current.bytesSpilled;
+}
+
+void SQLlite::printCompression(const vector<string>& tokens){
+    if(tokens.size() != 1){
+        cout << "Error during COMPRESSION: Expected format 'COMPRESSION <table>'" << endl;
+        return;
+    }
+    auto tableIt = tables.find(tokens[0]);
+    if(tableIt == tables.end()){
+        cout << "Error during COMPRESSION: " << tokens[0] << " does not name a table in the database" << endl;
+        return;
+    }
+
+    const Table& table = tableIt->second;
+    cout << "Compression for " << tokens[0] << " (" << table.sealedBlocks << " sealed blocks of " << Table::BLOCK_ROWS << " rows, "
+         << table.rows.size() - table.sealedRows() << " rows not yet sealed):" << endl;
+    for(size_t colIdx = 0; colIdx < table.columnNames.size(); ++colIdx){
+        if(!table.isEncoded(colIdx)){
+            cout << "  " << table.columnNames[colIdx] << ": not compressed" << endl;
+            continue;
+        }
+
+        size_t codecBlocks[3] = {0, 0, 0};
+        size_t encodedBytes = 0;
+        for(const auto& segment : table.segments[colIdx]){
+            ++codecBlocks[static_cast<size_t>(segment.codec)];
+            encodedBytes += segment.bytes();
+        }
+        size_t fieldBytes = table.sealedRows() * sizeof(Field);
+
+        cout << "  " << table.columnNames[colIdx] << ": " << table.sealedRows() << " rows in " << encodedBytes << " bytes, " << fieldBytes << " bytes as Fields";
+        if(encodedBytes > 0){
+            ostringstream ratio;
+            ratio << fixed << setprecision(2) << double(fieldBytes) / encodedBytes;
+            cout << " (" << ratio.str() << "x)";
+        }
+        cout << ", run length " << codecBlocks[0] << ", frame of reference " << codecBlocks[1] << ", delta " << codecBlocks[2] << endl;
+    }
+
+    // whole table as stored now against the same rows with every cell a Field
+    size_t expandedBytes = table.rows.capacity() * sizeof(vector<Field>) + table.rows.size() * table.columnNames.size() * sizeof(Field);
+    cout << "  total: " << table.rowMemory() << " bytes stored, " << expandedBytes << " bytes expanded" << endl;
+}
+
+//approximate heap usage of an index, node overhead plus row id postings
+template<typename Index>
+static size_t indexMemory(const Index& index, size_t nodeOverhead){
+    size_t bytes = index.size() * (sizeof(typename Index::value_type) + nodeOverhead);
+    for(const auto& [key, postings] : index){
+        bytes += postings.capacity() * sizeof(size_t);
+    }
+    return bytes;
+}
+
+//rows, tail keys and segments together, the table's full data footprint
+size_t SQLlite::Table::rowMemory() const{
+    size_t bytes = rows.capacity() * sizeof(vector<Field>) + segmentMemory();
+    for(const auto& row : rows){
+        bytes += row.capacity() * sizeof(Field);
+    }
+    for(const auto& keys : tailKeys){
+        bytes += keys.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+size_t SQLlite::Table::segmentMemory() const{
+    size_t bytes = 0;
+    for(const auto& columnSegments : segments){
+        for(const auto& segment : columnSegments){
+            bytes += segment.bytes();
+        }
+    }
+    return bytes;
+}
+
+void SQLlite::printStats(){
+    cout << "Command statistics:" << endl;
+    for(const auto& [name, cmdStats] : stats.commands){
+        cout << "  " << name << ": " << cmdStats.count << " calls, total " << cmdStats.totalMicros << " us, avg " << cmdStats.totalMicros / cmdStats.count
+             << " us, max " << cmdStats.maxMicros << " us, p50 < " << cmdStats.percentile(0.5) << " us, p99 < " << cmdStats.percentile(0.99) << " us" << endl;
+    }
+
+    cout << "Rows scanned: " << stats.rowsScanned << ", rows returned: " << stats.rowsReturned << endl;
+    cout << "Index usage: hash hits " << stats.hashHits << ", hash misses " << stats.hashMisses << ", bst hits " << stats.bstHits
+         << ", bst misses " << stats.bstMisses << ", bitmap hits " << stats.bitmapHits << ", full scans " << stats.fullScans << ", zone map blocks skipped " << stats.blocksSkipped
+         << ", compressed blocks scanned " << stats.compressedBlocks << endl;
+    cout << "Bytes spilled to disk: " << stats.bytesSpilled << endl;
+    cout << "Result cache: " << cache.entries.size() << " entries, " << cache.bytesUsed << " of " << cache.capacity << " bytes, hits " << cache.hits
+         << ", misses " << cache.misses << ", evictions " << cache.evictions << endl;
+
+    for(const auto& [tableName, table] : tables){
+        size_t zoneBytes = 0;
+        for(const auto& columnZones : table.zones){
+            zoneBytes += columnZones.capacity() * sizeof(Table::ZoneMap);
+        }
+        cout << "Table " << tableName << ": " << table.rows.size() << " rows, " << table.rowMemory() << " bytes (" << table.segmentMemory()
+             << " in encoded segments), zone maps " << zoneBytes << " bytes" << endl;
+        for(const auto& [col, index] : table.hashIndex){
+            if(!index.empty()){
+                size_t bytes = index.bucket_count() * sizeof(void*) + indexMemory(index, sizeof(void*) + sizeof(size_t));
+                cout << "  hash index on " << col << ": " << index.size() << " keys, " << bytes << " bytes" << endl;
+            }
+        }
+        for(const auto& [col, index] : table.bstIndex){
+            if(!index.empty()){
+                cout << "  bst index on " << col << ": " << index.size() << " keys, " << indexMemory(index, 3 * sizeof(void*) + sizeof(int)) << " bytes" << endl;
+            }
+        }
+        for(const auto& [col, cracker] : table.crackers){
+            cout << "  cracker column on " << col << ": " << cracker.pieces.size() + 1 << " pieces, " << cracker.memory() << " bytes" << endl;
+        }
+        for(const auto& [col, index] : table.bitmapIndex){
+            if(!index.empty()){
+                size_t bytes = index.size() * (sizeof(pair<const Field, Bitmap>) + 3 * sizeof(void*) + sizeof(int));
+                for(const auto& [key, bitmap] : index){
+                    bytes += bitmap.memory();
+                }
+                cout << "  bitmap index on " << col << ": " << index.size() << " keys, " << bytes << " bytes" << endl;
+            }
+        }
+    }
+
+    for(const auto& [viewName, view] : views){
+        cout << "View " << viewName << ": " << view.pairs.size() << " rows, " << view.pairs.capacity() * sizeof(view.pairs[0]) << " bytes" << endl;
+    }
+}
+
 //create table function
 void SQLlite::createTable(const vector<string>& tokens){
     string tableName = tokens[0];
 
-    if(tables.find(tableName) != tables.end()){
+    if(tables.find(tableName) != tables.end() || views.find(tableName) != views.end()){
         cout << "Error during CREATE: Cannot create already existing table " << tableName << endl;
         return;
     }
@@ -146,7 +475,8 @@ void SQLlite::createTable(const vector<string>& tokens){
         columnNames.push_back(tokens[2+numCols+i]);
     }
 
-    tables.emplace(tableName, Table(columnNames, columnTypes));
+    auto [tableIt, inserted] = tables.emplace(tableName, Table(columnNames, columnTypes));
+    bumpVersion(tableIt->second);
 
     cout << "New table " << tableName << " with column(s)";
     for(const auto& name : columnNames){
@@ -158,11 +488,25 @@ void SQLlite::createTable(const vector<string>& tokens){
 
 void SQLlite::removeTable(const string& tableName){
     auto it = tables.find(tableName);
+    if(it == tables.end() && views.erase(tableName) > 0){
+        cout << "View " << tableName << " removed" << endl;
+        return;
+    }
     if(it == tables.end()){
         cout << "Error during REMOVE: " << tableName << " does not name a table in the database" << endl;
         return;
     }
 
+    //views over the table go with it
+    for(auto viewIt = views.begin(); viewIt != views.end(); ){
+        if(viewIt->second.spec.table1Name == tableName || viewIt->second.spec.table2Name == tableName){
+            viewIt = views.erase(viewIt);
+        } else {
+            ++viewIt;
+        }
+    }
+
+    //cached results are keyed on this table's version, so they die with it
     tables.erase(it);
     cout << "Table " << tableName << " removed" << endl;
 }
@@ -198,8 +542,11 @@ void SQLlite::insertInto(const vector<string>& tokens){
         return;
     }
 
-    for(int row = 0; row < numRows; ++row){
+    // a malformed row stops the insert, but the rows before it stay and still reach the indexes and views
+    bool failed = false;
+    for(int row = 0; row < numRows && !failed; ++row){
         vector<Field> newRow;
+        vector<uint64_t> keys(numCols);
         string line;
         string value;
         getline(cin, line);
@@ -212,7 +559,8 @@ void SQLlite::insertInto(const vector<string>& tokens){
 
         if(rowValues.size() != numCols){
             cout << "Error during INSERT: Expected " << numCols << " values, but got " << rowValues.size() << " on row " << row + 1 << endl;
-            return;
+            failed = true;
+            break;
         }
 
         for(size_t i = 0; i < numCols; ++i){
@@ -220,13 +568,18 @@ void SQLlite::insertInto(const vector<string>& tokens){
 
             try {
                 if(colType == ColumnType::Int){
-                    newRow.emplace_back(stoi(rowValues[i]));
+                    int value = stoi(rowValues[i]);
+                    newRow.emplace_back(value);
+                    keys[i] = Table::intKey(value);
                 } else if (colType == ColumnType::Double){
-                    newRow.emplace_back(stod(rowValues[i]));
+                    double value = stod(rowValues[i]);
+                    newRow.emplace_back(value);
+                    keys[i] = Table::doubleKey(value);
                 } else if (colType == ColumnType::String){
                     if(rowValues[i].find(' ') != string::npos){
                         cout << "Error during INSERT: String values must be a single word" << endl;
-                        return;
+                        failed = true;
+                        break;
                     }
                     newRow.emplace_back(rowValues[i]);
                 } else if (colType == ColumnType::Bool){
@@ -236,38 +589,56 @@ void SQLlite::insertInto(const vector<string>& tokens){
                         newRow.emplace_back(false);
                     } else {
                         cout << "Error during INSERT: Invalid boolean value" << endl;
-                        return;
+                        failed = true;
+                        break;
                     }
                 } else {
                     cout << "Error during INSERT: Invalid boolean value in row" << row + 1 << endl;
-                    return;
+                    failed = true;
+                    break;
                 }
             } catch (const exception&){
                 cout << "Error during INSERT: Invalid value for column " << table.columnNames[i] << " in row " << row + 1 << endl;
-                return;
+                failed = true;
+                break;
             }
         } 
-        table.rows.push_back(newRow);
+        if(failed){
+            break;
+        }
+        table.insertRow(newRow, keys);
+        bumpVersion(table);
     }
 
-    size_t endIndex = table.rows.size() - 1;
-
+    optional<Field> scratch;
     for(size_t colIdx = 0; colIdx < table.columnNames.size(); ++colIdx){
         const string& colName = table.columnNames[colIdx];
         if(table.hashIndex.find(colName) != table.hashIndex.end() && !table.hashIndex[colName].empty()){
-            for(size_t rowIdx = startIndex; rowIdx <= endIndex; ++rowIdx){
-                table.hashIndex[colName][table.rows[rowIdx][colIdx]].push_back(rowIdx);
+            for(size_t rowIdx = startIndex; rowIdx < table.rows.size(); ++rowIdx){
+                table.hashIndex[colName][table.cell(rowIdx, colIdx, scratch)].push_back(rowIdx);
             }
         }
 
         if(table.bstIndex.find(colName) != table.bstIndex.end() && !table.bstIndex[colName].empty()){
-            for(size_t rowIdx = startIndex; rowIdx <= endIndex; ++rowIdx){
-                table.bstIndex[colName][table.rows[rowIdx][colIdx]].push_back(rowIdx);
+            for(size_t rowIdx = startIndex; rowIdx < table.rows.size(); ++rowIdx){
+                table.bstIndex[colName][table.cell(rowIdx, colIdx, scratch)].push_back(rowIdx);
+            }
+        }
+
+        if(table.bitmapIndex.find(colName) != table.bitmapIndex.end() && !table.bitmapIndex[colName].empty()){
+            for(size_t rowIdx = startIndex; rowIdx < table.rows.size(); ++rowIdx){
+                table.bitmapIndex[colName][table.cell(rowIdx, colIdx, scratch)].add(rowIdx);
             }
         }
             
     }
 
+    updateViewsAfterInsert(tableName, startIndex);
+    if(failed){
+        return;
+    }
+
+    size_t endIndex = table.rows.size() - 1;
     cout << "Added " << numRows << " rows to " << tableName << " from position " << startIndex << " to " << endIndex << endl;
 }
 
@@ -323,13 +694,19 @@ void SQLlite::printTable(const vector<string>& tokens, bool quiet){
         cout << endl;
 
         //rows from selected columns
-        for(const auto& row: table.rows){
+        optional<Field> scratch;
+        for(size_t i = 0; i < table.rows.size(); ++i){
             for(int index : colIndices){
-                cout << row[index] << " ";
+                cout << table.cell(i, index, scratch) << " ";
             }
             cout << endl;
         }
     }
+    current.rowsScanned += table.rows.size();
+    current.rowsReturned += table.rows.size();
+    current.accessPath = "full scan";
+    ++current.fullScans;
+
     //summary
     cout << "Printed " << table.rows.size() << " matching rows from " << tableName << endl;
 }
@@ -401,27 +778,30 @@ void SQLlite::deleteFromTable(const vector<string>& tokens){
         Field value = parseValue(valueStr, table.columnTypes[colIndex]);
 
         vector<size_t> rowsToDelete;
-        for(size_t i = 0; i < table.rows.size(); ++i){
-            if((op == "<" && table.rows[i][colIndex] < value) ||
-                (op == ">" && table.rows[i][colIndex] > value) || 
-                (op == "=" && table.rows[i][colIndex] == value)){
-                rowsToDelete.push_back(i);
-            }
+        if(table.bitmapIndex.count(colName) > 0 && !table.bitmapIndex[colName].empty()){
+            table.bitmapWhere(colName, parseCompareOp(op), value).forEach([&](size_t row){ rowsToDelete.push_back(row); });
+            ++current.bitmapHits;
+            current.accessPath = "bitmap index";
+        } else if(adaptive && op != "=" && !table.hasIndex(colName)){
+            rowsToDelete = table.crackWhere(colIndex, parseCompareOp(op), value, current);
+        } else {
+            rowsToDelete = table.scanWhere(colIndex, parseCompareOp(op), value, current);
         }
-
-
-        auto newEnd = remove_if(table.rows.begin(), table.rows.end(), Table::RowMatch(colIndex, op, value));
-        size_t numDeleted = distance(newEnd, table.rows.end());
-        table.rows.erase(newEnd, table.rows.end());
-
-        // Update the hash and BST indices
+        size_t numDeleted = rowsToDelete.size();
+        current.rowsReturned += numDeleted;
+        table.eraseRows(rowsToDelete);
+        updateViewsAfterDelete(tableName, rowsToDelete);
+        bumpVersion(table);
+
+        // Update the hash, BST and bitmap indices
+        optional<Field> scratch;
         for(size_t colIdx = 0; colIdx < table.columnNames.size(); ++colIdx){
             const string& currentColName = table.columnNames[colIdx];
 
             if(table.hashIndex.find(currentColName) != table.hashIndex.end() && !table.hashIndex[currentColName].empty()){
                 unordered_map<Field, vector<size_t>> newIndex;
                 for(size_t i = 0; i < table.rows.size(); ++i){
-                    newIndex[table.rows[i][colIdx]].push_back(i);
+                    newIndex[table.cell(i, colIdx, scratch)].push_back(i);
                 }
                 table.hashIndex[currentColName] = move(newIndex);
             }
@@ -429,10 +809,18 @@ void SQLlite::deleteFromTable(const vector<string>& tokens){
             if(table.bstIndex.find(currentColName) != table.bstIndex.end() && !table.bstIndex[currentColName].empty()){
                 map<Field, vector<size_t>> newIndex;
                 for(size_t i = 0; i < table.rows.size(); ++i){
-                    newIndex[table.rows[i][colIdx]].push_back(i);
+                    newIndex[table.cell(i, colIdx, scratch)].push_back(i);
                 }
                 table.bstIndex[currentColName] = move(newIndex);
             }
+
+            if(table.bitmapIndex.find(currentColName) != table.bitmapIndex.end() && !table.bitmapIndex[currentColName].empty()){
+                map<Field, Bitmap> newIndex;
+                for(size_t i = 0; i < table.rows.size(); ++i){
+                    newIndex[table.cell(i, colIdx, scratch)].add(i);
+                }
+                table.bitmapIndex[currentColName] = move(newIndex);
+            }
         }
         
 
@@ -453,127 +841,1253 @@ void SQLlite::Table::generateIndex(const string& col, const string& type, const
     size_t colIndex = distance(columnNames.begin(), it);
     hashIndex[col].clear();
     bstIndex[col].clear();
+    bitmapIndex[col].clear();
+    crackers.erase(col);
 
+    optional<Field> scratch;
     if(type == "hash"){
         unordered_map<Field, vector<size_t>> newIndex;
         for(size_t i = 0; i < rows.size(); ++i){
-            newIndex[rows[i][colIndex]].push_back(i);
+            newIndex[cell(i, colIndex, scratch)].push_back(i);
         }
         hashIndex[col] = move(newIndex);
         cout << "Generated hash index for table " << tableName << " on column " << col << ", with " << hashIndex[col].size() << " distinct keys" << endl;
     } else if(type == "bst"){
         map<Field, vector<size_t>> newIndex;
         for(size_t i = 0; i < rows.size(); ++i){
-            newIndex[rows[i][colIndex]].push_back(i);
+            newIndex[cell(i, colIndex, scratch)].push_back(i);
         }
         bstIndex[col] = move(newIndex);
         cout << "Generated bst index for table " << tableName << " on column " << col << ", with " << bstIndex[col].size() << " distinct keys" << endl;
+    } else if(type == "bitmap"){
+        map<Field, Bitmap> newIndex;
+        for(size_t i = 0; i < rows.size(); ++i){
+            newIndex[cell(i, colIndex, scratch)].add(i);
+        }
+        bitmapIndex[col] = move(newIndex);
+        cout << "Generated bitmap index for table " << tableName << " on column " << col << ", with " << bitmapIndex[col].size() << " distinct keys" << endl;
     } else {
         cout << "Error during GENERATE: Invalid index type '" << type << "'" << endl;
     }
 }
 
-void SQLlite::Table::printWhere(const vector<string>& selectedColumns, const string& whereCol, const string& op, const Field& val, bool quiet, const string& tableName){
-    vector<int> colIndices;
-    for(const auto& col : selectedColumns){
-        auto it = find(columnNames.begin(), columnNames.end(), col);
-        if(it == columnNames.end()){
-            cout << "Error during PRINT: " << col << " does not name a column in " << tableName << endl;
-            return;
+//shifts a row id down past the deleted rows before it, returns true if the row itself was deleted
+static bool renumberAfterDelete(const vector<size_t>& deletedRows, size_t& row){
+    auto pos = lower_bound(deletedRows.begin(), deletedRows.end(), row);
+    bool gone = pos != deletedRows.end() && *pos == row;
+    row -= distance(deletedRows.begin(), pos);
+    return gone;
+}
+
+//rows whose column equals key, through whichever index the column has
+//whether col has a built hash or bst index. GENERATE leaves empty entries behind for the other types
+bool SQLlite::Table::hasIndex(const string& col) const{
+    auto hashIt = hashIndex.find(col);
+    auto bstIt = bstIndex.find(col);
+    return (hashIt != hashIndex.end() && !hashIt->second.empty()) || (bstIt != bstIndex.end() && !bstIt->second.empty());
+}
+
+vector<size_t> SQLlite::Table::lookupEqual(size_t colIndex, const Field& key, ExecStats& exec) const{
+    const string& col = columnNames[colIndex];
+
+    auto hashIt = hashIndex.find(col);
+    if(hashIt != hashIndex.end() && !hashIt->second.empty()){
+        auto it = hashIt->second.find(key);
+        return it != hashIt->second.end() ? it->second : vector<size_t>();
+    }
+
+    auto bstIt = bstIndex.find(col);
+    if(bstIt != bstIndex.end() && !bstIt->second.empty()){
+        auto it = bstIt->second.find(key);
+        return it != bstIt->second.end() ? it->second : vector<size_t>();
+    }
+
+    auto bitmapIt = bitmapIndex.find(col);
+    if(bitmapIt != bitmapIndex.end() && !bitmapIt->second.empty()){
+        vector<size_t> matchingRows;
+        auto it = bitmapIt->second.find(key);
+        if(it != bitmapIt->second.end()){
+            it->second.forEach([&](size_t row){ matchingRows.push_back(row); });
         }
-        colIndices.push_back(static_cast<int>(distance(columnNames.begin(), it)));
+        return matchingRows;
     }
 
-    auto whereIt = find(columnNames.begin(), columnNames.end(), whereCol);
-    if(whereIt == columnNames.end()){
-        cout << "Error during PRINT: " << whereCol << " does not name column in " << tableName << endl;
-        return;
+    return scanWhere(colIndex, CompareOp::Equal, key, exec);
+}
+
+//range query through the column's cracker, creating it on first use
+vector<size_t> SQLlite::Table::crackWhere(size_t colIndex, CompareOp op, const Field& val, ExecStats& exec){
+    auto [it, created] = crackers.try_emplace(columnNames[colIndex]);
+    CrackerColumn& cracker = it->second;
+    size_t scanned = 0;
+
+    if(created){
+        cracker.entries.reserve(rows.size());
+        optional<Field> scratch;
+        for(size_t i = 0; i < rows.size(); ++i){
+            const Field& value = cell(i, colIndex, scratch);
+            if(value == value){
+                cracker.entries.push_back({value, i});
+            }
+        }
+    } else if(!cracker.pending.empty()){
+        scanned += cracker.entries.size();
+        cracker.merge(*this, colIndex);
     }
 
-    size_t whereColIndex = distance(columnNames.begin(), whereIt);
     vector<size_t> matchingRows;
-    bool foundWithIndex = false;
-
-    if(op == "=" && hashIndex.count(whereCol) > 0){
-        auto valueIt = hashIndex[whereCol].find(val);
-        if(valueIt != hashIndex[whereCol].end()){
-            matchingRows = valueIt->second;
-            foundWithIndex = true;
+    if(!(val == val)){
+        // a nan bound matches nothing and has no place among the boundaries
+    } else if(op == CompareOp::Less){
+        size_t pos = cracker.crack({val, false}, scanned);
+        for(size_t i = 0; i < pos; ++i){
+            matchingRows.push_back(cracker.entries[i].row);
         }
-    } else if(bstIndex.count(whereCol) > 0){
-        if(op == "="){
-            auto valueIt = bstIndex[whereCol].find(val);
-            if(valueIt != bstIndex[whereCol].end()){
-                matchingRows = valueIt->second;
-                foundWithIndex = true;
+    } else {
+        size_t pos = cracker.crack({val, true}, scanned);
+        for(size_t i = pos; i < cracker.entries.size(); ++i){
+            matchingRows.push_back(cracker.entries[i].row);
+        }
+    }
+    sort(matchingRows.begin(), matchingRows.end());
+
+    exec.rowsScanned += scanned;
+    exec.accessPath = "cracker column (" + to_string(cracker.pieces.size() + 1) + " pieces)";
+    return matchingRows;
+}
+
+//partitions the piece holding the bound, returns the bound's position
+size_t SQLlite::Table::CrackerColumn::crack(const Boundary& bound, size_t& scanned){
+    auto upper = pieces.upper_bound(bound);
+    if(upper != pieces.begin() && !(prev(upper)->first < bound)){
+        return prev(upper)->second;
+    }
+
+    size_t start = upper == pieces.begin() ? 0 : prev(upper)->second;
+    size_t end = upper == pieces.end() ? entries.size() : upper->second;
+    auto mid = partition(entries.begin() + start, entries.begin() + end, [&](const Entry& entry){ return bound.before(entry.value); });
+    scanned += end - start;
+
+    size_t pos = distance(entries.begin(), mid);
+    pieces.emplace(bound, pos);
+    return pos;
+}
+
+//replays logged inserts and deletes in order so row ids match the table again
+void SQLlite::Table::CrackerColumn::merge(const Table& table, size_t colIndex){
+    vector<size_t> inserted;
+
+    for(const Update& update : pending){
+        if(!update.isDelete){
+            for(size_t row = update.begin; row < update.end; ++row){
+                inserted.push_back(row);
             }
-        } else if (op == "<"){
-            for(auto it = bstIndex[whereCol].begin(); it != bstIndex[whereCol].end() && it->first < val; ++it){
-                matchingRows.insert(matchingRows.end(), it->second.begin(), it->second.end());
-                foundWithIndex = true;
+            continue;
+        }
+
+        auto renumber = [&](size_t& row){ return renumberAfterDelete(update.rows, row); };
+
+        size_t kept = 0;
+        auto bound = pieces.begin();
+        for(size_t i = 0; i < entries.size(); ++i){
+            for(; bound != pieces.end() && bound->second == i; ++bound){
+                bound->second = kept;
             }
-        } else if(op == ">"){
-            for(auto it = bstIndex[whereCol].upper_bound(val); it != bstIndex[whereCol].end(); ++it){
-                matchingRows.insert(matchingRows.end(), it->second.begin(), it->second.end());
-                foundWithIndex = true;
+            if(renumber(entries[i].row)){
+                continue;
             }
-        } 
-    } 
-    
-    if(!foundWithIndex){
-        for(size_t i = 0; i < rows.size(); ++i){
-            if((op == "<" && rows[i][whereColIndex] < val) ||
-                (op == ">" && rows[i][whereColIndex] > val) || 
-                (op == "=" && rows[i][whereColIndex] == val)){   
-                matchingRows.push_back(i);
+            if(kept != i){
+                entries[kept] = move(entries[i]);
             }
+            ++kept;
         }
-    }
-        
-    if(!quiet){
-        for(const auto& colIdx : colIndices){
-            cout << columnNames[colIdx] << " ";
+        for(; bound != pieces.end(); ++bound){
+            bound->second = kept;
         }
-        cout << endl;
+        entries.erase(entries.begin() + kept, entries.end());
 
-        for(size_t rowIndex : matchingRows){
-            for(int colIdx : colIndices){
-                cout << rows[rowIndex][colIdx] << " ";
+        size_t keptInserts = 0;
+        for(size_t row : inserted){
+            if(!renumber(row)){
+                inserted[keptInserts++] = row;
             }
-            cout << endl;
         }
+        inserted.resize(keptInserts);
     }
 
-    cout << "Printed " << matchingRows.size() << " matching rows from " << tableName << endl;
+    optional<Field> scratch;
+    for(size_t row : inserted){
+        const Field& value = table.cell(row, colIndex, scratch);
+        if(value == value){
+            rippleInsert({value, row});
+        }
+    }
+    pending.clear();
 }
 
-// JOIN <table1> AND <table2> WHERE <col1> = <col2> AND PRINT <N> <printcol1> ... <printcoln>
-void SQLlite::joinTables(const vector<string>& tokens){
-    if(tokens.size() < 9){
-        cout << "Error during JOIN: Invalid command format" << endl;
-        return;
+//moves the first entry of every later piece to that piece's end, opening a slot in the right piece
+void SQLlite::Table::CrackerColumn::rippleInsert(const Entry& entry){
+    auto target = pieces.lower_bound({entry.value, true});
+    size_t hole = entries.size();
+    entries.push_back(entry);
+
+    for(auto it = pieces.end(); it != target; ){
+        --it;
+        if(hole != it->second){
+            entries[hole] = move(entries[it->second]);
+        }
+        hole = it->second;
+        ++it->second;
     }
+    if(hole != entries.size() - 1){
+        entries[hole] = entry;
+    }
+}
 
-    string table1Name = tokens[0];
+void SQLlite::Table::CrackerColumn::logInsert(size_t row){
+    if(!pending.empty() && !pending.back().isDelete && pending.back().end == row){
+        ++pending.back().end;
+    } else {
+        pending.push_back({false, row, row + 1, {}});
+    }
+}
 
-    if(tokens[1] != "AND"){
-        cout << "Error during JOIN: Expected 'AND' after first table name" << endl;
-        return;
+size_t SQLlite::Table::CrackerColumn::memory() const{
+    size_t bytes = entries.capacity() * sizeof(Entry) + pieces.size() * (sizeof(pair<const Boundary, size_t>) + 3 * sizeof(void*) + sizeof(int));
+    for(const Update& update : pending){
+        bytes += sizeof(Update) + update.rows.capacity() * sizeof(size_t);
     }
+    return bytes;
+}
 
-    string table2Name = tokens[2];
+SQLlite::CompareOp SQLlite::parseCompareOp(const string& op){
+    if(op == "<")
+        return CompareOp::Less;
+    else if(op == ">")
+        return CompareOp::Greater;
+    return CompareOp::Equal;
+}
 
-    auto table1It = tables.find(table1Name);
-    auto table2It = tables.find(table2Name);
+template<SQLlite::CompareOp Op>
+void SQLlite::Table::scanKernel(const vector<vector<Field>>& rows, size_t slot, const Field& val, size_t begin, size_t end, vector<size_t>& out){
+    ValueMatch<Op> match{val};
+    for(size_t i = begin; i < end; ++i){
+        if(match(rows[i][slot])){
+            out.push_back(i);
+        }
+    }
+}
 
-    if(table1It == tables.end()){
-        cout << "Error during JOIN: " << table1Name << " does not name a table in the database" << endl;
+//kernel table is indexed by CompareOp
+SQLlite::Table::ScanKernel SQLlite::Table::scanKernelFor(CompareOp op){
+    static const ScanKernel kernels[] = {scanKernel<CompareOp::Less>, scanKernel<CompareOp::Greater>, scanKernel<CompareOp::Equal>};
+    return kernels[static_cast<size_t>(op)];
+}
+
+void SQLlite::Table::keyScanKernel(const uint64_t* keys, size_t count, uint64_t from, uint64_t to, size_t firstRow, vector<size_t>& out){
+    if(from > to){
         return;
     }
-
+    // one unsigned compare per key, wrapping keys below from around past the interval
+    uint64_t width = to - from;
+    for(size_t i = 0; i < count; ++i){
+        if(keys[i] - from <= width){
+            out.push_back(firstRow + i);
+        }
+    }
+}
+
+SQLlite::Table::Table(vector<string> names, vector<ColumnType> types)
+    : columnNames(move(names)), columnTypes(move(types)), zones(columnNames.size()), segments(columnNames.size()),
+      tailKeys(columnNames.size()), plainSlot(columnNames.size()){
+    size_t slot = 0;
+    for(size_t colIdx = 0; colIdx < columnTypes.size(); ++colIdx){
+        if(!isEncoded(colIdx)){
+            plainSlot[colIdx] = slot++;
+        }
+    }
+}
+
+//keys holds the order preserving key of every int and double value in the row
+void SQLlite::Table::insertRow(const vector<Field>& row, const vector<uint64_t>& keys){
+    size_t block = rows.size() / BLOCK_ROWS;
+    rows.push_back(row);
+
+    for(size_t colIdx = 0; colIdx < zones.size(); ++colIdx){
+        if(zones[colIdx].size() <= block){
+            zones[colIdx].emplace_back(row[colIdx]);
+        } else {
+            zones[colIdx][block].add(row[colIdx]);
+        }
+        if(isEncoded(colIdx)){
+            tailKeys[colIdx].push_back(keys[colIdx]);
+        }
+    }
+
+    for(auto& [col, cracker] : crackers){
+        cracker.logInsert(rows.size() - 1);
+    }
+
+    if(rows.size() % BLOCK_ROWS == 0){
+        sealBlock();
+    }
+}
+
+//removes the given sorted row ids, keeping the remaining rows in order. blocks before the first
+//removed row stay sealed, later blocks go back to keys, are compacted and sealed again
+void SQLlite::Table::eraseRows(const vector<size_t>& rowIds){
+    if(rowIds.empty()){
+        return;
+    }
+
+    size_t firstBlock = min(rowIds[0] / BLOCK_ROWS, sealedBlocks);
+    size_t begin = firstBlock * BLOCK_ROWS;
+    for(size_t colIdx = 0; colIdx < columnTypes.size(); ++colIdx){
+        if(!isEncoded(colIdx)){
+            continue;
+        }
+        vector<uint64_t> keys;
+        keys.reserve(rows.size() - begin);
+        for(size_t block = firstBlock; block < sealedBlocks; ++block){
+            segments[colIdx][block].decode(keys);
+        }
+        keys.insert(keys.end(), tailKeys[colIdx].begin(), tailKeys[colIdx].end());
+        tailKeys[colIdx] = move(keys);
+        segments[colIdx].resize(firstBlock);
+    }
+    sealedBlocks = firstBlock;
+
+    size_t next = 0;
+    size_t kept = begin;
+    for(size_t i = begin; i < rows.size(); ++i){
+        if(next < rowIds.size() && rowIds[next] == i){
+            ++next;
+            continue;
+        }
+        if(kept != i){
+            rows[kept] = move(rows[i]);
+            for(size_t colIdx = 0; colIdx < tailKeys.size(); ++colIdx){
+                if(isEncoded(colIdx)){
+                    tailKeys[colIdx][kept - begin] = tailKeys[colIdx][i - begin];
+                }
+            }
+        }
+        ++kept;
+    }
+    rows.erase(rows.begin() + kept, rows.end());
+    for(size_t colIdx = 0; colIdx < tailKeys.size(); ++colIdx){
+        if(isEncoded(colIdx)){
+            tailKeys[colIdx].resize(kept - begin);
+        }
+    }
+
+    // rows from a sealed block that now fall past the last full block need all their cells back
+    for(size_t i = begin + (kept - begin) / BLOCK_ROWS * BLOCK_ROWS; i < kept; ++i){
+        if(rows[i].size() == columnNames.size()){
+            continue;
+        }
+        vector<Field> full;
+        full.reserve(columnNames.size());
+        for(size_t colIdx = 0; colIdx < columnTypes.size(); ++colIdx){
+            if(isEncoded(colIdx)){
+                full.push_back(decodeKey(tailKeys[colIdx][i - begin], columnTypes[colIdx]));
+            } else {
+                full.push_back(move(rows[i][plainSlot[colIdx]]));
+            }
+        }
+        rows[i] = move(full);
+    }
+    while(rows.size() - sealedRows() >= BLOCK_ROWS){
+        sealBlock();
+    }
+    rebuildZones(firstBlock);
+
+    for(auto& [col, cracker] : crackers){
+        cracker.pending.push_back({true, 0, 0, rowIds});
+    }
+}
+
+void SQLlite::Table::rebuildZones(size_t firstBlock){
+    for(size_t colIdx = 0; colIdx < zones.size(); ++colIdx){
+        zones[colIdx].erase(zones[colIdx].begin() + firstBlock, zones[colIdx].end());
+        optional<Field> scratch;
+        for(size_t i = firstBlock * BLOCK_ROWS; i < rows.size(); ++i){
+            const Field& value = cell(i, colIdx, scratch);
+            if(i % BLOCK_ROWS == 0){
+                zones[colIdx].emplace_back(value);
+            } else {
+                zones[colIdx].back().add(value);
+            }
+        }
+    }
+}
+
+//moves the int and double cells of the first unsealed block, which must be full, into segments.
+//rows that still hold every cell are cut down to their string and bool cells
+void SQLlite::Table::sealBlock(){
+    size_t begin = sealedRows();
+    vector<size_t> plainColumns;
+    for(size_t colIdx = 0; colIdx < columnTypes.size(); ++colIdx){
+        if(!isEncoded(colIdx)){
+            plainColumns.push_back(colIdx);
+            continue;
+        }
+        segments[colIdx].push_back(Segment::encode(tailKeys[colIdx].data(), BLOCK_ROWS));
+        tailKeys[colIdx].erase(tailKeys[colIdx].begin(), tailKeys[colIdx].begin() + BLOCK_ROWS);
+    }
+
+    if(plainColumns.size() < columnNames.size()){
+        for(size_t i = begin; i < begin + BLOCK_ROWS; ++i){
+            if(rows[i].size() != columnNames.size()){
+                continue;
+            }
+            vector<Field> plain;
+            plain.reserve(plainColumns.size());
+            for(size_t colIdx : plainColumns){
+                plain.push_back(move(rows[i][colIdx]));
+            }
+            rows[i] = move(plain);
+        }
+    }
+    ++sealedBlocks;
+}
+
+//value of one cell. stored cells are returned in place, cells of sealed int and double blocks are
+//decoded from their segment into scratch, which must outlive the returned reference
+const Field& SQLlite::Table::cell(size_t row, size_t colIndex, optional<Field>& scratch) const{
+    if(row >= sealedRows()){
+        return rows[row][colIndex];
+    }
+    if(!isEncoded(colIndex)){
+        return rows[row][plainSlot[colIndex]];
+    }
+
+    scratch.emplace(decodeKey(key(row, colIndex), columnTypes[colIndex]));
+    return *scratch;
+}
+
+//order preserving key of an int or double cell
+uint64_t SQLlite::Table::key(size_t row, size_t colIndex) const{
+    if(row >= sealedRows()){
+        return tailKeys[colIndex][row - sealedRows()];
+    }
+    return segments[colIndex][row / BLOCK_ROWS].at(row % BLOCK_ROWS);
+}
+
+static constexpr uint64_t SIGN_BIT = uint64_t(1) << 63;
+
+//keys sort like the values: ints are offset by 2^63, positive doubles get the sign bit set and
+//negative doubles have every bit flipped
+uint64_t SQLlite::Table::intKey(int value){
+    return static_cast<uint64_t>(static_cast<int64_t>(value)) ^ SIGN_BIT;
+}
+
+uint64_t SQLlite::Table::doubleKey(double value){
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & SIGN_BIT) ? ~bits : bits | SIGN_BIT;
+}
+
+Field SQLlite::Table::decodeKey(uint64_t key, ColumnType type){
+    if(type == ColumnType::Int){
+        return Field(static_cast<int>(static_cast<int64_t>(key ^ SIGN_BIT)));
+    }
+    uint64_t bits = (key & SIGN_BIT) ? key ^ SIGN_BIT : ~key;
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return Field(value);
+}
+
+//keys [from, to] of exactly the values that compare to val, found by binary searching the key
+//domain with Field's own comparisons so encoded blocks match the same rows a Field scan would
+void SQLlite::Table::keyInterval(ColumnType type, CompareOp op, const Field& val, uint64_t& from, uint64_t& to){
+    from = 1;
+    to = 0;
+    if(!(val == val)){
+        return; // nan, equal to nothing
+    }
+
+    uint64_t lowest = type == ColumnType::Int ? intKey(numeric_limits<int>::min()) : doubleKey(-numeric_limits<double>::infinity());
+    uint64_t highest = type == ColumnType::Int ? intKey(numeric_limits<int>::max()) : doubleKey(numeric_limits<double>::infinity());
+    auto firstNotBefore = [&](auto before){
+        uint64_t lo = lowest;
+        uint64_t hi = highest + 1;
+        while(lo < hi){
+            uint64_t mid = lo + (hi - lo) / 2;
+            if(before(decodeKey(mid, type))){
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    };
+    uint64_t equalBegin = firstNotBefore([&](const Field& value){ return value < val; });
+    uint64_t equalEnd = firstNotBefore([&](const Field& value){ return !(value > val); });
+
+    switch(op){
+        case CompareOp::Less:
+            from = lowest;
+            to = equalBegin - 1;
+            break;
+        case CompareOp::Greater:
+            from = equalEnd;
+            to = highest;
+            break;
+        case CompareOp::Equal:
+            from = equalBegin;
+            to = equalEnd - 1;
+            break;
+    }
+}
+
+//keys [from, to] of the values equal to the one with the given key. equality on keys is equality
+//on values except that -0 and 0 are equal and nan equals nothing
+void SQLlite::Table::equalKeys(ColumnType type, uint64_t key, uint64_t& from, uint64_t& to){
+    from = key;
+    to = key;
+    if(type != ColumnType::Double){
+        return;
+    }
+
+    uint64_t negativeZero = doubleKey(-0.0);
+    uint64_t positiveZero = doubleKey(0.0);
+    if(key == negativeZero || key == positiveZero){
+        from = negativeZero;
+        to = positiveZero;
+    } else if(key < doubleKey(-numeric_limits<double>::infinity()) || key > doubleKey(numeric_limits<double>::infinity())){
+        from = 1;
+        to = 0;
+    }
+}
+
+static unsigned bitsNeeded(uint64_t value){
+    unsigned bits = 0;
+    while(bits < 64 && (value >> bits) != 0){
+        ++bits;
+    }
+    return bits;
+}
+
+//picks whichever of run length, frame of reference and delta encodes the block smallest
+SQLlite::Table::Segment SQLlite::Table::Segment::encode(const uint64_t* keys, size_t count){
+    Segment segment;
+    segment.count = count;
+
+    size_t numRuns = 1;
+    bool sorted = true;
+    uint64_t minKey = keys[0];
+    uint64_t maxKey = keys[0];
+    uint64_t maxDelta = 0;
+    for(size_t i = 1; i < count; ++i){
+        numRuns += keys[i] != keys[i - 1];
+        sorted = sorted && keys[i] >= keys[i - 1];
+        if(sorted){
+            maxDelta = max(maxDelta, keys[i] - keys[i - 1]);
+        }
+        minKey = min(minKey, keys[i]);
+        maxKey = max(maxKey, keys[i]);
+    }
+
+    unsigned forWidth = bitsNeeded(maxKey - minKey);
+    unsigned deltaWidth = bitsNeeded(maxDelta);
+    size_t runBytes = numRuns * sizeof(pair<uint64_t, uint32_t>);
+    size_t forBytes = (count * forWidth + 63) / 64 * sizeof(uint64_t);
+    size_t deltaBytes = sorted ? ((count - 1) * deltaWidth + 63) / 64 * sizeof(uint64_t) + (count + DELTA_STRIDE - 1) / DELTA_STRIDE * sizeof(uint64_t) : SIZE_MAX;
+
+    if(runBytes <= forBytes && runBytes <= deltaBytes){
+        segment.codec = Codec::RunLength;
+        segment.runs.reserve(numRuns);
+        for(size_t i = 0; i < count; ++i){
+            if(i == 0 || keys[i] != keys[i - 1]){
+                segment.runs.emplace_back(keys[i], i);
+            }
+            ++segment.runs.back().second;
+        }
+        return segment;
+    }
+
+    vector<uint64_t> codes;
+    codes.reserve(count);
+    if(deltaBytes < forBytes){
+        segment.codec = Codec::Delta;
+        segment.base = keys[0];
+        segment.bitWidth = deltaWidth;
+        for(size_t i = 1; i < count; ++i){
+            codes.push_back(keys[i] - keys[i - 1]);
+        }
+        for(size_t i = 0; i < count; i += DELTA_STRIDE){
+            segment.anchors.push_back(keys[i]);
+        }
+    } else {
+        segment.codec = Codec::FrameOfReference;
+        segment.base = minKey;
+        segment.bitWidth = forWidth;
+        for(size_t i = 0; i < count; ++i){
+            codes.push_back(keys[i] - minKey);
+        }
+    }
+
+    // one spare word so packedAt can always read the word after a value
+    segment.packed.assign((codes.size() * segment.bitWidth + 63) / 64 + 1, 0);
+    for(size_t i = 0; i < codes.size() && segment.bitWidth > 0; ++i){
+        size_t bit = i * segment.bitWidth;
+        segment.packed[bit >> 6] |= codes[i] << (bit & 63);
+        if((bit & 63) + segment.bitWidth > 64){
+            segment.packed[(bit >> 6) + 1] |= codes[i] >> (64 - (bit & 63));
+        }
+    }
+    return segment;
+}
+
+//appends the block's keys in row order
+void SQLlite::Table::Segment::decode(vector<uint64_t>& keys) const{
+    if(codec == Codec::RunLength){
+        size_t start = 0;
+        for(const auto& [value, end] : runs){
+            keys.insert(keys.end(), end - start, value);
+            start = end;
+        }
+    } else if(codec == Codec::FrameOfReference){
+        for(size_t i = 0; i < count; ++i){
+            keys.push_back(base + packedAt(i));
+        }
+    } else {
+        uint64_t value = base;
+        keys.push_back(value);
+        for(size_t i = 1; i < count; ++i){
+            value += packedAt(i - 1);
+            keys.push_back(value);
+        }
+    }
+}
+
+//key at position i: one packed offset, a binary search over the runs, or at most
+//DELTA_STRIDE - 1 deltas added to the nearest anchor
+uint64_t SQLlite::Table::Segment::at(size_t i) const{
+    if(codec == Codec::RunLength){
+        auto run = upper_bound(runs.begin(), runs.end(), i, [](size_t row, const pair<uint64_t, uint32_t>& r){ return row < r.second; });
+        return run->first;
+    }
+    if(codec == Codec::FrameOfReference){
+        return base + packedAt(i);
+    }
+    uint64_t value = anchors[i / DELTA_STRIDE];
+    for(size_t j = i / DELTA_STRIDE * DELTA_STRIDE; j < i; ++j){
+        value += packedAt(j);
+    }
+    return value;
+}
+
+uint64_t SQLlite::Table::Segment::packedAt(size_t i) const{
+    if(bitWidth == 0){
+        return 0;
+    }
+    size_t bit = i * bitWidth;
+    uint64_t value = packed[bit >> 6] >> (bit & 63);
+    if((bit & 63) + bitWidth > 64){
+        value |= packed[(bit >> 6) + 1] << (64 - (bit & 63));
+    }
+    return bitWidth == 64 ? value : value & ((uint64_t(1) << bitWidth) - 1);
+}
+
+//appends the rows whose key lies in [from, to]: tested once per run, on frame of reference
+//offsets, or on the running sum of deltas, where sorted order ends the scan at the first key past to
+void SQLlite::Table::Segment::scan(uint64_t from, uint64_t to, size_t firstRow, vector<size_t>& out) const{
+    if(from > to){
+        return;
+    }
+
+    if(codec == Codec::RunLength){
+        size_t start = 0;
+        for(const auto& [value, end] : runs){
+            if(value >= from && value <= to){
+                for(size_t i = start; i < end; ++i){
+                    out.push_back(firstRow + i);
+                }
+            }
+            start = end;
+        }
+    } else if(codec == Codec::FrameOfReference){
+        if(to < base){
+            return;
+        }
+        uint64_t low = from > base ? from - base : 0;
+        uint64_t high = to - base;
+        for(size_t i = 0; i < count; ++i){
+            uint64_t code = packedAt(i);
+            if(code >= low && code <= high){
+                out.push_back(firstRow + i);
+            }
+        }
+    } else {
+        uint64_t value = base;
+        for(size_t i = 0; i < count; ++i){
+            if(i > 0){
+                value += packedAt(i - 1);
+            }
+            if(value > to){
+                return;
+            }
+            if(value >= from){
+                out.push_back(firstRow + i);
+            }
+        }
+    }
+}
+
+size_t SQLlite::Table::Segment::bytes() const{
+    return sizeof(Segment) + (packed.capacity() + anchors.capacity()) * sizeof(uint64_t) + runs.capacity() * sizeof(runs[0]);
+}
+
+bool SQLlite::Table::blockMayMatch(size_t colIndex, size_t block, CompareOp op, const Field& val) const{
+    const ZoneMap& zone = zones[colIndex][block];
+    switch(op){
+        case CompareOp::Less:
+            return zone.min < val;
+        case CompareOp::Greater:
+            return zone.max > val;
+        case CompareOp::Equal:
+            return !(val < zone.min) && !(val > zone.max);
+    }
+    return false;
+}
+
+//appends the rows whose column compares to val, in row order. blocks whose zone map rules out
+//the predicate are skipped. int and double columns are tested on their keys against [from, to],
+//the key interval of the predicate, and string and bool columns on their Fields
+void SQLlite::Table::matchRows(size_t colIndex, CompareOp op, const Field& val, uint64_t from, uint64_t to, vector<size_t>& out, ExecStats& exec) const{
+    ScanKernel kernel = scanKernelFor(op);
+    bool encoded = isEncoded(colIndex);
+
+    for(size_t block = 0; block < zones[colIndex].size(); ++block){
+        if(!blockMayMatch(colIndex, block, op, val)){
+            ++exec.blocksSkipped;
+            continue;
+        }
+
+        size_t begin = block * BLOCK_ROWS;
+        size_t end = min(rows.size(), begin + BLOCK_ROWS);
+        if(!encoded){
+            kernel(rows, block >= sealedBlocks ? colIndex : plainSlot[colIndex], val, begin, end, out);
+        } else if(block >= sealedBlocks){
+            keyScanKernel(tailKeys[colIndex].data() + (begin - sealedRows()), end - begin, from, to, begin, out);
+        } else {
+            segments[colIndex][block].scan(from, to, begin, out);
+            ++exec.compressedBlocks;
+        }
+        exec.rowsScanned += end - begin;
+    }
+}
+
+//full scan that skips every block whose zone map rules out the predicate
+vector<size_t> SQLlite::Table::scanWhere(size_t colIndex, CompareOp op, const Field& val, ExecStats& exec) const{
+    uint64_t from = 1;
+    uint64_t to = 0;
+    if(isEncoded(colIndex)){
+        keyInterval(columnTypes[colIndex], op, val, from, to);
+    }
+
+    vector<size_t> matchingRows;
+    ExecStats scan;
+    matchRows(colIndex, op, val, from, to, matchingRows, scan);
+
+    ++exec.fullScans;
+    exec.rowsScanned += scan.rowsScanned;
+    exec.blocksSkipped += scan.blocksSkipped;
+    exec.compressedBlocks += scan.compressedBlocks;
+    if(scan.blocksSkipped > 0){
+        exec.accessPath = "zone map scan (" + to_string(scan.blocksSkipped) + " of " + to_string(zones[colIndex].size()) + " blocks skipped)";
+    } else {
+        exec.accessPath = "full scan";
+    }
+    if(scan.compressedBlocks > 0){
+        exec.accessPath += ", " + to_string(scan.compressedBlocks) + " blocks read encoded";
+    }
+    return matchingRows;
+}
+
+SQLlite::JoinedRows::~JoinedRows(){
+    if(file != nullptr){
+        fclose(file);
+    }
+}
+
+void SQLlite::JoinedRows::emplace_back(size_t row1, size_t row2){
+    buffer.emplace_back(row1, row2);
+    ++count;
+    if(memoryLimit > 0 && buffer.size() * sizeof(buffer[0]) >= memoryLimit){
+        flush();
+    }
+}
+
+//appends the buffered pairs to the spill file in one sequential write
+void SQLlite::JoinedRows::flush(){
+    if(file == nullptr){
+        file = tmpfile();
+        if(file == nullptr){
+            memoryLimit = 0; // no temp space, keep everything in memory
+            return;
+        }
+    }
+    size_t written = fwrite(buffer.data(), sizeof(buffer[0]), buffer.size(), file);
+    spilledBytes += written * sizeof(buffer[0]);
+    buffer.erase(buffer.begin(), buffer.begin() + written);
+    if(!buffer.empty()){
+        memoryLimit = 0; // short write, likely out of disk, keep the rest in memory
+    }
+}
+
+//visits every pair in the order it was added, spilled pairs first
+template<typename Visit>
+void SQLlite::JoinedRows::forEach(Visit visit){
+    if(file != nullptr && spilledBytes > 0){
+        fflush(file);
+        rewind(file);
+
+        vector<pair<size_t, size_t>> chunk(max<size_t>(1, memoryLimit / sizeof(chunk[0])));
+        size_t remaining = spilledBytes / sizeof(chunk[0]);
+        while(remaining > 0){
+            size_t got = fread(chunk.data(), sizeof(chunk[0]), min(chunk.size(), remaining), file);
+            if(got == 0){
+                break;
+            }
+            for(size_t i = 0; i < got; ++i){
+                visit(chunk[i].first, chunk[i].second);
+            }
+            remaining -= got;
+        }
+        fseek(file, 0, SEEK_END);
+    }
+
+    for(const auto& [row1, row2] : buffer){
+        visit(row1, row2);
+    }
+}
+
+//splitmix64 finalizer, spreads weak std::hash values over all 64 bits
+uint64_t SQLlite::BloomFilter::mix(uint64_t h){
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+void SQLlite::BloomFilter::add(const Field& key){
+    uint64_t h = mix(hash<Field>{}(key));
+    auto& block = blocks[h % blocks.size()];
+    uint64_t probes = mix(h); // re-mixed so the probe bits are independent of the block choice
+    for(size_t i = 0; i < NUM_PROBES; ++i){
+        size_t bit = (probes >> (9 * i)) & 511;
+        block[bit >> 6] |= uint64_t(1) << (bit & 63);
+    }
+}
+
+bool SQLlite::BloomFilter::mayContain(const Field& key) const{
+    uint64_t h = mix(hash<Field>{}(key));
+    const auto& block = blocks[h % blocks.size()];
+    uint64_t probes = mix(h); // re-mixed so the probe bits are independent of the block choice
+    for(size_t i = 0; i < NUM_PROBES; ++i){
+        size_t bit = (probes >> (9 * i)) & 511;
+        if((block[bit >> 6] & (uint64_t(1) << (bit & 63))) == 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+SQLlite::BloomFilter SQLlite::Table::buildBloom(size_t colIndex) const{
+    BloomFilter filter(rows.size());
+    optional<Field> scratch;
+    for(size_t i = 0; i < rows.size(); ++i){
+        filter.add(cell(i, colIndex, scratch));
+    }
+    return filter;
+}
+
+//rows whose value in colIndex may be in the filter, in row order
+vector<size_t> SQLlite::Table::bloomScan(size_t colIndex, const BloomFilter& filter) const{
+    vector<size_t> candidates;
+    optional<Field> scratch;
+    for(size_t i = 0; i < rows.size(); ++i){
+        if(filter.mayContain(cell(i, colIndex, scratch))){
+            candidates.push_back(i);
+        }
+    }
+    return candidates;
+}
+
+SQLlite::Bitmap SQLlite::Bitmap::range(size_t numRows){
+    Bitmap bitmap;
+    for(size_t start = 0; start < numRows; start += 65536){
+        Container container;
+        container.key = start >> 16;
+        container.cardinality = min<size_t>(65536, numRows - start);
+        if(container.cardinality <= ARRAY_MAX){
+            for(size_t i = 0; i < container.cardinality; ++i){
+                container.values.push_back(static_cast<uint16_t>(i));
+            }
+        } else {
+            container.words.assign(WORDS, 0);
+            for(size_t i = 0; i < container.cardinality / 64; ++i){
+                container.words[i] = ~uint64_t(0);
+            }
+            if(container.cardinality % 64 != 0){
+                container.words[container.cardinality / 64] = (uint64_t(1) << (container.cardinality % 64)) - 1;
+            }
+        }
+        bitmap.containers.push_back(move(container));
+    }
+    return bitmap;
+}
+
+//appending rows in increasing order only touches the last container
+void SQLlite::Bitmap::add(size_t row){
+    size_t key = row >> 16;
+    uint16_t low = static_cast<uint16_t>(row & 0xFFFF);
+
+    auto it = containers.end();
+    if(containers.empty() || containers.back().key < key){
+        containers.emplace_back();
+        containers.back().key = key;
+        it = containers.end() - 1;
+    } else {
+        it = lower_bound(containers.begin(), containers.end(), key, [](const Container& c, size_t k){ return c.key < k; });
+        if(it == containers.end() || it->key != key){
+            it = containers.emplace(it);
+            it->key = key;
+        }
+    }
+
+    Container& container = *it;
+    if(container.isBitset()){
+        uint64_t bit = uint64_t(1) << (low & 63);
+        if((container.words[low >> 6] & bit) == 0){
+            container.words[low >> 6] |= bit;
+            ++container.cardinality;
+        }
+        return;
+    }
+
+    if(container.values.empty() || container.values.back() < low){
+        container.values.push_back(low);
+    } else {
+        auto pos = lower_bound(container.values.begin(), container.values.end(), low);
+        if(*pos == low){
+            return;
+        }
+        container.values.insert(pos, low);
+    }
+    if(++container.cardinality > ARRAY_MAX){
+        container.toBitset();
+    }
+}
+
+size_t SQLlite::Bitmap::cardinality() const{
+    size_t total = 0;
+    for(const Container& container : containers){
+        total += container.cardinality;
+    }
+    return total;
+}
+
+size_t SQLlite::Bitmap::memory() const{
+    size_t bytes = containers.capacity() * sizeof(Container);
+    for(const Container& container : containers){
+        bytes += container.values.capacity() * sizeof(uint16_t) + container.words.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+//visits row ids in increasing order
+template<typename Visit>
+void SQLlite::Bitmap::forEach(Visit visit) const{
+    for(const Container& container : containers){
+        size_t base = container.key << 16;
+        if(container.isBitset()){
+            for(size_t w = 0; w < WORDS; ++w){
+                uint64_t word = container.words[w];
+                while(word != 0){
+                    visit(base + w * 64 + __builtin_ctzll(word));
+                    word &= word - 1;
+                }
+            }
+        } else {
+            for(uint16_t low : container.values){
+                visit(base + low);
+            }
+        }
+    }
+}
+
+vector<uint64_t> SQLlite::Bitmap::Container::asWords() const{
+    if(isBitset()){
+        return words;
+    }
+    vector<uint64_t> result(WORDS, 0);
+    for(uint16_t low : values){
+        result[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    return result;
+}
+
+void SQLlite::Bitmap::Container::toBitset(){
+    words = asWords();
+    vector<uint16_t>().swap(values);
+}
+
+void SQLlite::Bitmap::Container::toArray(){
+    values.clear();
+    values.reserve(cardinality);
+    for(size_t w = 0; w < WORDS; ++w){
+        uint64_t word = words[w];
+        while(word != 0){
+            values.push_back(static_cast<uint16_t>(w * 64 + __builtin_ctzll(word)));
+            word &= word - 1;
+        }
+    }
+    vector<uint64_t>().swap(words);
+}
+
+SQLlite::Bitmap::Container SQLlite::Bitmap::combine(const Container& a, const Container& b, SetOp op){
+    Container result;
+    result.key = a.key;
+
+    if(!a.isBitset() && !b.isBitset()){
+        if(op == SetOp::And){
+            set_intersection(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(), back_inserter(result.values));
+        } else if(op == SetOp::Or){
+            set_union(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(), back_inserter(result.values));
+        } else {
+            set_difference(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(), back_inserter(result.values));
+        }
+        result.cardinality = result.values.size();
+        if(result.cardinality > ARRAY_MAX){
+            result.toBitset();
+        }
+        return result;
+    }
+
+    result.words = a.asWords();
+    vector<uint64_t> other = b.asWords();
+    for(size_t w = 0; w < WORDS; ++w){
+        if(op == SetOp::And){
+            result.words[w] &= other[w];
+        } else if(op == SetOp::Or){
+            result.words[w] |= other[w];
+        } else {
+            result.words[w] &= ~other[w];
+        }
+        result.cardinality += __builtin_popcountll(result.words[w]);
+    }
+    if(result.cardinality <= ARRAY_MAX){
+        result.toArray();
+    }
+    return result;
+}
+
+//merges the two container lists by key, dropping containers that end up empty
+SQLlite::Bitmap SQLlite::Bitmap::combine(const Bitmap& a, const Bitmap& b, SetOp op){
+    Bitmap result;
+    size_t i = 0;
+    size_t j = 0;
+
+    while(i < a.containers.size() || j < b.containers.size()){
+        bool takeA = j == b.containers.size() || (i < a.containers.size() && a.containers[i].key < b.containers[j].key);
+        bool takeB = i == a.containers.size() || (j < b.containers.size() && b.containers[j].key < a.containers[i].key);
+
+        if(takeA){
+            if(op != SetOp::And){
+                result.containers.push_back(a.containers[i]);
+            }
+            ++i;
+        } else if(takeB){
+            if(op == SetOp::Or){
+                result.containers.push_back(b.containers[j]);
+            }
+            ++j;
+        } else {
+            Container merged = combine(a.containers[i], b.containers[j], op);
+            if(merged.cardinality > 0){
+                result.containers.push_back(move(merged));
+            }
+            ++i;
+            ++j;
+        }
+    }
+    return result;
+}
+
+//rows satisfying the predicate, built from the per value bitmaps. ranges union whichever
+//side of the value has fewer keys, subtracting from all rows when that is the complement
+SQLlite::Bitmap SQLlite::Table::bitmapWhere(const string& col, CompareOp op, const Field& val) const{
+    const map<Field, Bitmap>& index = bitmapIndex.at(col);
+
+    if(op == CompareOp::Equal){
+        auto it = index.find(val);
+        return it != index.end() ? it->second : Bitmap();
+    }
+
+    auto split = op == CompareOp::Less ? index.lower_bound(val) : index.upper_bound(val);
+    auto matchBegin = op == CompareOp::Less ? index.begin() : split;
+    auto matchEnd = op == CompareOp::Less ? split : index.end();
+    auto restBegin = op == CompareOp::Less ? split : index.begin();
+    auto restEnd = op == CompareOp::Less ? index.end() : split;
+
+    Bitmap result;
+    if(distance(matchBegin, matchEnd) <= distance(restBegin, restEnd)){
+        for(auto it = matchBegin; it != matchEnd; ++it){
+            result = result | it->second;
+        }
+        return result;
+    }
+
+    for(auto it = restBegin; it != restEnd; ++it){
+        result = result | it->second;
+    }
+    return Bitmap::range(rows.size()).andNot(result);
+}
+
+void SQLlite::Table::printWhere(const vector<string>& selectedColumns, const string& whereCol, const string& op, const Field& val, bool quiet, bool adaptive, const string& tableName, ExecStats& exec){
+    vector<int> colIndices;
+    for(const auto& col : selectedColumns){
+        auto it = find(columnNames.begin(), columnNames.end(), col);
+        if(it == columnNames.end()){
+            cout << "Error during PRINT: " << col << " does not name a column in " << tableName << endl;
+            return;
+        }
+        colIndices.push_back(static_cast<int>(distance(columnNames.begin(), it)));
+    }
+
+    auto whereIt = find(columnNames.begin(), columnNames.end(), whereCol);
+    if(whereIt == columnNames.end()){
+        cout << "Error during PRINT: " << whereCol << " does not name column in " << tableName << endl;
+        return;
+    }
+
+    size_t whereColIndex = distance(columnNames.begin(), whereIt);
+    vector<size_t> matchingRows;
+    bool foundWithIndex = false;
+    string indexUsed;
+
+    if(bitmapIndex.count(whereCol) > 0 && !bitmapIndex[whereCol].empty()){
+        indexUsed = "bitmap";
+        Bitmap matches = bitmapWhere(whereCol, parseCompareOp(op), val);
+        if(quiet){
+            //only the count is printed, which the bitmap already knows
+            size_t count = matches.cardinality();
+            ++exec.bitmapHits;
+            exec.rowsReturned += count;
+            exec.accessPath = "bitmap index";
+            cout << "Printed " << count << " matching rows from " << tableName << endl;
+            return;
+        }
+        matches.forEach([&](size_t row){ matchingRows.push_back(row); });
+        foundWithIndex = true;
+    } else if(op == "=" && hashIndex.count(whereCol) > 0){
+        if(!hashIndex[whereCol].empty()){
+            indexUsed = "hash";
+        }
+        auto valueIt = hashIndex[whereCol].find(val);
+        if(valueIt != hashIndex[whereCol].end()){
+            matchingRows = valueIt->second;
+            foundWithIndex = true;
+        }
+    } else if(bstIndex.count(whereCol) > 0){
+        if(!bstIndex[whereCol].empty()){
+            indexUsed = "bst";
+        }
+        if(op == "="){
+            auto valueIt = bstIndex[whereCol].find(val);
+            if(valueIt != bstIndex[whereCol].end()){
+                matchingRows = valueIt->second;
+                foundWithIndex = true;
+            }
+        } else if (op == "<"){
+            for(auto it = bstIndex[whereCol].begin(); it != bstIndex[whereCol].end() && it->first < val; ++it){
+                matchingRows.insert(matchingRows.end(), it->second.begin(), it->second.end());
+                foundWithIndex = true;
+            }
+        } else if(op == ">"){
+            for(auto it = bstIndex[whereCol].upper_bound(val); it != bstIndex[whereCol].end(); ++it){
+                matchingRows.insert(matchingRows.end(), it->second.begin(), it->second.end());
+                foundWithIndex = true;
+            }
+        } 
+    } 
+    
+    if(!foundWithIndex){
+        if(adaptive && !hasIndex(whereCol) && op != "="){
+            matchingRows = crackWhere(whereColIndex, parseCompareOp(op), val, exec);
+        } else {
+            matchingRows = scanWhere(whereColIndex, parseCompareOp(op), val, exec);
+        }
+
+        if(indexUsed == "hash"){
+            ++exec.hashMisses;
+        } else if(indexUsed == "bst"){
+            ++exec.bstMisses;
+        }
+    } else {
+        if(indexUsed == "hash"){
+            ++exec.hashHits;
+        } else if(indexUsed == "bst"){
+            ++exec.bstHits;
+        } else {
+            ++exec.bitmapHits;
+        }
+        exec.rowsScanned += matchingRows.size();
+        exec.accessPath = indexUsed + " index";
+    }
+    exec.rowsReturned += matchingRows.size();
+        
+    if(!quiet){
+        for(const auto& colIdx : colIndices){
+            cout << columnNames[colIdx] << " ";
+        }
+        cout << endl;
+
+        optional<Field> scratch;
+        for(size_t rowIndex : matchingRows){
+            for(int colIdx : colIndices){
+                cout << cell(rowIndex, colIdx, scratch) << " ";
+            }
+            cout << endl;
+        }
+    }
+
+    cout << "Printed " << matchingRows.size() << " matching rows from " << tableName << endl;
+}
+
+// JOIN <table1> AND <table2> WHERE <col1> = <col2> AND PRINT <N> <printcol1> ... <printcoln>
+bool SQLlite::parseJoin(const vector<string>& tokens, JoinSpec& spec){
+    if(tokens.size() < 9){
+        cout << "Error during JOIN: Invalid command format" << endl;
+        return false;
+    }
+
+    string table1Name = tokens[0];
+
+    if(tokens[1] != "AND"){
+        cout << "Error during JOIN: Expected 'AND' after first table name" << endl;
+        return false;
+    }
+
+    string table2Name = tokens[2];
+
+    auto table1It = tables.find(table1Name);
+    auto table2It = tables.find(table2Name);
+
+    if(table1It == tables.end()){
+        cout << "Error during JOIN: " << table1Name << " does not name a table in the database" << endl;
+        return false;
+    }
+
     if(table2It == tables.end()){
         cout << "Error during JOIN: " << table2Name << " does not name a table in the database" << endl;
-        return;
+        return false;
     }
 
     Table& table1 = table1It->second;
@@ -583,13 +2097,13 @@ void SQLlite::joinTables(const vector<string>& tokens){
     auto whereIt = find(tokens.begin(), tokens.end(), "WHERE");
     if(whereIt == tokens.end() || distance(whereIt, tokens.end()) < 4){
         cout << "Error during JOIN: Missing or Incomplete WHERE clause" << endl;
-        return;
+        return false;
     }
 
     string column1 = *(whereIt + 1);
     if(*(whereIt + 2) != "="){
         cout << "Error during JOIN: Invalid comparison operator" << endl;
-        return;
+        return false;
     }
 
     string column2 = *(whereIt + 3);
@@ -599,11 +2113,11 @@ void SQLlite::joinTables(const vector<string>& tokens){
     auto col2It = find(table2.columnNames.begin(), table2.columnNames.end(), column2);
     if(col1It == table1.columnNames.end()){
         cout << "Error during JOIN: " << column1 << " does not name a column in " << table1Name << endl;
-        return;
+        return false;
     }
     if(col2It == table2.columnNames.end()){
         cout << "Error during JOIN: " << column2 << " does not name a column in " << table2Name << endl;
-        return;
+        return false;
     }
 
     int col1Index = static_cast<int>(distance(table1.columnNames.begin(), col1It));
@@ -612,14 +2126,14 @@ void SQLlite::joinTables(const vector<string>& tokens){
     //ensure matching column types
     if(table1.columnTypes[col1Index] != table2.columnTypes[col2Index]){
         cout << "Error during JOIN: Column types do not match for join columns" << endl;
-        return;
+        return false;
     }
 
     //print token and extract print columns
     auto andPrintIt = find(tokens.begin() + 3, tokens.end(), "AND");
     if(andPrintIt == tokens.end() || distance(andPrintIt, tokens.end()) < 2 || *(andPrintIt + 1) != "PRINT"){
         cout << "Error during JOIN: Missing or incomplete PRINT clause" << endl;
-        return;
+        return false;
     }
 
 
@@ -628,16 +2142,16 @@ void SQLlite::joinTables(const vector<string>& tokens){
         numPrintCols = stoi(*(andPrintIt + 2));
         if(numPrintCols <= 0){
             cout << "Error during JOIN: Number of columns to print must be positive" << endl;
-            return;
+            return false;
         }
     } catch (...) {
         cout << "Error during JOIN: Invalid number of columns to print" << endl;
-        return;
+        return false;
     }
 
     if(distance(andPrintIt + 3, tokens.end()) < 2 * numPrintCols){
         cout << "Error during JOIN: Not enough columns to print" << endl;
-        return;
+        return false;
     }
 
 
@@ -654,11 +2168,11 @@ void SQLlite::joinTables(const vector<string>& tokens){
             tableNum = stoi(tableNumStr);
             if(tableNum != 1 && tableNum != 2){
                 cout << "Error during JOIN: Table indicator must be 1 or 2" << endl;
-                return;
+                return false;
             }
         } catch (...){
             cout << "Error during JOIN: Invalid table indicator" << endl;
-            return;
+            return false;
         }
         printColumnInfo.emplace_back(colName, tableNum);
     }
@@ -672,14 +2186,50 @@ void SQLlite::joinTables(const vector<string>& tokens){
         auto colIt = find(table.columnNames.begin(), table.columnNames.end(), colName);
         if(colIt == table.columnNames.end()){
             cout << "Error during JOIN: " << colName << " does not name a column in " << tableName << endl;
-            return;
+            return false;
         }
         
         int colIndex = static_cast<int>(distance(table.columnNames.begin(), colIt));
         printColIndices.emplace_back(tableNum, colIndex);
     }
 
-    vector<pair<size_t, size_t>> joinedRows;
+    spec = {table1Name, table2Name, column1, column2, col1Index, col2Index, move(printColumnInfo), move(printColIndices)};
+    return true;
+}
+
+//matches rows of the two tables into joinedRows in output order
+void SQLlite::computeJoin(const JoinSpec& spec, JoinedRows& joinedRows){
+    Table& table1 = tables.at(spec.table1Name);
+    Table& table2 = tables.at(spec.table2Name);
+    const string& column1 = spec.column1;
+    const string& column2 = spec.column2;
+    int col1Index = spec.col1Index;
+    int col2Index = spec.col2Index;
+
+    // join columns share a type, so int and double columns match on keys taken straight from table1
+    ColumnType joinType = table1.columnTypes[col1Index];
+    bool keyed = table1.isEncoded(col1Index);
+
+    // every table2 row equal to table1's row, through table2's zone maps and encoded blocks
+    vector<size_t> matches;
+    ExecStats probe;
+    auto joinRange = [&](const Field& key, size_t rowIdx1){
+        uint64_t from = 1;
+        uint64_t to = 0;
+        if(keyed){
+            Table::equalKeys(joinType, table1.key(rowIdx1, col1Index), from, to);
+        }
+        matches.clear();
+        table2.matchRows(col2Index, CompareOp::Equal, key, from, to, matches, probe);
+        for(size_t rowIdx2 : matches){
+            joinedRows.emplace_back(rowIdx1, rowIdx2);
+        }
+    };
+    optional<Field> scratch1;
+    optional<Field> scratch2;
+    bool usedBloom = false;
+    size_t bloomComparisons = 0;
+    size_t bloomDiscarded = 0;
 
     bool table1HasHashIndex = table1.hashIndex.count(column1) > 0 && !table1.hashIndex[column1].empty();
     bool table2HasHashIndex = table2.hashIndex.count(column2) > 0 && !table2.hashIndex[column2].empty();
@@ -688,7 +2238,7 @@ void SQLlite::joinTables(const vector<string>& tokens){
 
     if (table1HasHashIndex) {
         for (size_t rowIdx1 = 0; rowIdx1 < table1.rows.size(); ++rowIdx1) {
-            const Field& joinValue1 = table1.rows[rowIdx1][col1Index];
+            const Field& joinValue1 = table1.cell(rowIdx1, col1Index, scratch1);
 
             if (table2HasHashIndex) {
                 // both have hash indices
@@ -700,18 +2250,13 @@ void SQLlite::joinTables(const vector<string>& tokens){
                 }
             } else {
                 // table1 has hash, table2 doesn't
-                for (size_t rowIdx2 = 0; rowIdx2 < table2.rows.size(); ++rowIdx2) {
-                    const Field& joinValue2 = table2.rows[rowIdx2][col2Index];
-                    if (joinValue1 == joinValue2) {
-                        joinedRows.emplace_back(rowIdx1, rowIdx2);
-                    }
-                }
+                joinRange(joinValue1, rowIdx1);
             }
         }
     } else if (table1HasBSTIndex) {
         // table1 has BST index
         for (size_t rowIdx1 = 0; rowIdx1 < table1.rows.size(); ++rowIdx1) {
-            const Field& joinValue1 = table1.rows[rowIdx1][col1Index];
+            const Field& joinValue1 = table1.cell(rowIdx1, col1Index, scratch1);
 
             if (table2HasBSTIndex) {
                 // Both have BST indices
@@ -723,18 +2268,59 @@ void SQLlite::joinTables(const vector<string>& tokens){
                 }
             } else {
                 // table1 has BST, table2 doesn't
-                for (size_t rowIdx2 = 0; rowIdx2 < table2.rows.size(); ++rowIdx2) {
-                    const Field& joinValue2 = table2.rows[rowIdx2][col2Index];
-                    if (joinValue1 == joinValue2) {
+                joinRange(joinValue1, rowIdx1);
+            }
+        }
+    } else if (!table2HasHashIndex && !table2HasBSTIndex) {
+        // no index on either side, filter the larger side with a bloom filter
+        // over the smaller side's keys so only possible matches reach the nested loop
+        bool buildOnTable1 = table1.rows.size() <= table2.rows.size();
+        BloomFilter filter = buildOnTable1 ? table1.buildBloom(col1Index) : table2.buildBloom(col2Index);
+        vector<size_t> candidates = buildOnTable1 ? table2.bloomScan(col2Index, filter) : table1.bloomScan(col1Index, filter);
+
+        if (buildOnTable1 && keyed) {
+            // candidates are compared once per table1 row, gather their keys instead of decoding each time
+            vector<uint64_t> candidateKeys;
+            candidateKeys.reserve(candidates.size());
+            for (size_t rowIdx2 : candidates) {
+                candidateKeys.push_back(table2.key(rowIdx2, col2Index));
+            }
+
+            for (size_t rowIdx1 = 0; rowIdx1 < table1.rows.size(); ++rowIdx1) {
+                uint64_t from, to;
+                Table::equalKeys(joinType, table1.key(rowIdx1, col1Index), from, to);
+                if (from > to) {
+                    continue;
+                }
+                uint64_t width = to - from;
+                for (size_t i = 0; i < candidates.size(); ++i) {
+                    if (candidateKeys[i] - from <= width) {
+                        joinedRows.emplace_back(rowIdx1, candidates[i]);
+                    }
+                }
+            }
+        } else if (buildOnTable1) {
+            for (size_t rowIdx1 = 0; rowIdx1 < table1.rows.size(); ++rowIdx1) {
+                const Field& joinValue1 = table1.cell(rowIdx1, col1Index, scratch1);
+                for (size_t rowIdx2 : candidates) {
+                    if (table2.cell(rowIdx2, col2Index, scratch2) == joinValue1) {
                         joinedRows.emplace_back(rowIdx1, rowIdx2);
                     }
                 }
             }
+        } else {
+            for (size_t rowIdx1 : candidates) {
+                joinRange(table1.cell(rowIdx1, col1Index, scratch1), rowIdx1);
+            }
         }
+
+        usedBloom = true;
+        bloomComparisons = candidates.size() * (buildOnTable1 ? table1.rows.size() : table2.rows.size());
+        bloomDiscarded = (buildOnTable1 ? table2.rows.size() : table1.rows.size()) - candidates.size();
     } else {
         // no index on table1, iterate through all rows
         for (size_t rowIdx1 = 0; rowIdx1 < table1.rows.size(); ++rowIdx1) {
-            const Field& joinValue1 = table1.rows[rowIdx1][col1Index];
+            const Field& joinValue1 = table1.cell(rowIdx1, col1Index, scratch1);
 
             // use index on table2 if available
             if (table2HasHashIndex) {
@@ -755,16 +2341,181 @@ void SQLlite::joinTables(const vector<string>& tokens){
                 }
             } else {
                 // No index on table2, iterate through all rows
-                for (size_t rowIdx2 = 0; rowIdx2 < table2.rows.size(); ++rowIdx2) {
-                    const Field& joinValue2 = table2.rows[rowIdx2][col2Index];
-                    if (joinValue1 == joinValue2) {
-                        joinedRows.emplace_back(rowIdx1, rowIdx2);
+                joinRange(joinValue1, rowIdx1);
+            }
+        }
+    }
+
+    string probeIndex;
+    if(table1HasHashIndex){
+        probeIndex = table2HasHashIndex ? "hash" : "";
+    } else if(table1HasBSTIndex){
+        probeIndex = table2HasBSTIndex ? "bst" : "";
+    } else {
+        probeIndex = table2HasHashIndex ? "hash" : (table2HasBSTIndex ? "bst" : "");
+    }
+
+    if(usedBloom){
+        current.rowsScanned += table1.rows.size() + table2.rows.size() + bloomComparisons;
+        current.accessPath = "bloom semi-join (" + to_string(bloomDiscarded) + " rows discarded)";
+        current.fullScans += 2;
+    } else if(probeIndex.empty()){
+        current.rowsScanned += table1.rows.size() + table1.rows.size() * table2.rows.size();
+        current.accessPath = "nested loop";
+        ++current.fullScans;
+    } else {
+        current.rowsScanned += table1.rows.size() + joinedRows.size();
+        current.accessPath = probeIndex + " index";
+        ++(probeIndex == "hash" ? current.hashHits : current.bstHits);
+    }
+    current.blocksSkipped += probe.blocksSkipped;
+    current.compressedBlocks += probe.compressedBlocks;
+    current.rowsReturned += joinedRows.size();
+    current.bytesSpilled += joinedRows.bytesSpilled();
+}
+
+// CREATE VIEW <name> AS JOIN <table1> AND <table2> WHERE <col1> = <col2> AND PRINT <N> <printcol1> ... <printcoln>
+void SQLlite::createView(const vector<string>& tokens){
+    string viewName = tokens[1];
+    if(tables.find(viewName) != tables.end() || views.find(viewName) != views.end()){
+        cout << "Error during CREATE: Cannot create already existing view " << viewName << endl;
+        return;
+    }
+    if(tokens.size() < 4 || tokens[3] != "JOIN"){
+        cout << "Error during CREATE: Expected format 'CREATE VIEW <name> AS JOIN ...'" << endl;
+        return;
+    }
+
+    View view;
+    if(!parseJoin(vector<string>(tokens.begin() + 4, tokens.end()), view.spec)){
+        return;
+    }
+
+    // the join spills past the memory limit like JOIN does, so only the stored pairs stay resident
+    JoinedRows joinedRows(memoryLimit);
+    computeJoin(view.spec, joinedRows);
+    view.pairs.reserve(joinedRows.size());
+    joinedRows.forEach([&](size_t idx1, size_t idx2){ view.pairs.emplace_back(idx1, idx2); });
+
+    cout << "New view " << viewName << " with " << view.pairs.size() << " rows from joining " << view.spec.table1Name << " to " << view.spec.table2Name << " created" << endl;
+    views.emplace(viewName, move(view));
+}
+
+void SQLlite::printView(const string& viewName){
+    const View& view = views.at(viewName);
+    const Table& table1 = tables.at(view.spec.table1Name);
+    const Table& table2 = tables.at(view.spec.table2Name);
+
+    if(!quiet){
+        for(const auto& [colName, tableNum] : view.spec.printColumnInfo){
+            cout << colName << " ";
+        }
+        cout << endl;
+
+        optional<Field> scratch;
+        for(const auto& [idx1, idx2] : view.pairs){
+            for(const auto& [tableNum, colIdx] : view.spec.printColIndices){
+                if(tableNum == 1){
+                    cout << table1.cell(idx1, colIdx, scratch) << " ";
+                } else {
+                    cout << table2.cell(idx2, colIdx, scratch) << " ";
+                }
+            }
+            cout << endl;
+        }
+    }
+
+    current.rowsScanned += view.pairs.size();
+    current.rowsReturned += view.pairs.size();
+    current.accessPath = "materialized view";
+    cout << "Printed " << view.pairs.size() << " rows from view " << viewName << endl;
+}
+
+//joins only the rows added since startIndex against the other side of each view over the table
+void SQLlite::updateViewsAfterInsert(const string& tableName, size_t startIndex){
+    for(auto& [viewName, view] : views){
+        const JoinSpec& spec = view.spec;
+        if(spec.table1Name != tableName && spec.table2Name != tableName){
+            continue;
+        }
+
+        const Table& table1 = tables.at(spec.table1Name);
+        const Table& table2 = tables.at(spec.table2Name);
+        ExecStats probe;
+        optional<Field> scratch;
+
+        // new left rows sort after every stored pair
+        if(spec.table1Name == tableName){
+            for(size_t idx1 = startIndex; idx1 < table1.rows.size(); ++idx1){
+                for(size_t idx2 : table2.lookupEqual(spec.col2Index, table1.cell(idx1, spec.col1Index, scratch), probe)){
+                    view.pairs.emplace_back(idx1, idx2);
+                }
+            }
+        }
+
+        // new right rows pair with existing left rows and are merged into place. in a self
+        // join the new left rows already met every right row above
+        if(spec.table2Name == tableName){
+            size_t oldLeftRows = spec.table1Name == tableName ? startIndex : table1.rows.size();
+            vector<pair<size_t, size_t>> added;
+            for(size_t idx2 = startIndex; idx2 < table2.rows.size(); ++idx2){
+                for(size_t idx1 : table1.lookupEqual(spec.col1Index, table2.cell(idx2, spec.col2Index, scratch), probe)){
+                    if(idx1 < oldLeftRows){
+                        added.emplace_back(idx1, idx2);
                     }
                 }
             }
+
+            sort(added.begin(), added.end());
+            size_t oldSize = view.pairs.size();
+            view.pairs.insert(view.pairs.end(), added.begin(), added.end());
+            inplace_merge(view.pairs.begin(), view.pairs.begin() + oldSize, view.pairs.end());
         }
+        current.rowsScanned += probe.rowsScanned;
     }
-    
+}
+
+//drops the pairs that reference deleted rows and renumbers the rest
+void SQLlite::updateViewsAfterDelete(const string& tableName, const vector<size_t>& deletedRows){
+    if(deletedRows.empty()){
+        return;
+    }
+
+    for(auto& [viewName, view] : views){
+        bool left = view.spec.table1Name == tableName;
+        bool right = view.spec.table2Name == tableName;
+        if(!left && !right){
+            continue;
+        }
+
+        size_t kept = 0;
+        for(auto [idx1, idx2] : view.pairs){
+            // no short circuit, a self join renumbers both sides
+            bool gone = (left && renumberAfterDelete(deletedRows, idx1)) | (right && renumberAfterDelete(deletedRows, idx2));
+            if(!gone){
+                view.pairs[kept++] = {idx1, idx2};
+            }
+        }
+        view.pairs.resize(kept);
+    }
+}
+
+void SQLlite::joinTables(const vector<string>& tokens){
+    JoinSpec spec;
+    if(!parseJoin(tokens, spec)){
+        return;
+    }
+
+    JoinedRows joinedRows(memoryLimit);
+    computeJoin(spec, joinedRows);
+
+    const Table& table1 = tables.at(spec.table1Name);
+    const Table& table2 = tables.at(spec.table2Name);
+    const auto& printColumnInfo = spec.printColumnInfo;
+    const auto& printColIndices = spec.printColIndices;
+    const string& table1Name = spec.table1Name;
+    const string& table2Name = spec.table2Name;
+
     //print join results
     if(!quiet){
         for(const auto& [colName, tableNum]: printColumnInfo){
@@ -773,16 +2524,17 @@ void SQLlite::joinTables(const vector<string>& tokens){
         cout << endl;
     
 
-        for(const auto& [idx1, idx2] : joinedRows){
+        optional<Field> scratch;
+        joinedRows.forEach([&](size_t idx1, size_t idx2){
             for(const auto& [tableNum, colIdx] : printColIndices){
                 if(tableNum == 1){
-                    cout << table1.rows[idx1][colIdx] << " ";
+                    cout << table1.cell(idx1, colIdx, scratch) << " ";
                 } else {
-                    cout << table2.rows[idx2][colIdx] << " ";
+                    cout << table2.cell(idx2, colIdx, scratch) << " ";
                 }
             }
             cout << endl;
-        }
+        });
     }
 
     cout << "Printed " << joinedRows.size() << " rows from joining " << table1Name << " to " << table2Name << endl;
@@ -3,58 +3,405 @@
 #include <unordered_map>
 #include <vector>
 #include <map>
+#include <list>
+#include <array>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
 
 using namespace std;
 
 class SQLlite{
     public:
-        explicit SQLlite(bool quietMode = false) : quiet(quietMode) {}
-        void processCommand(const string& cmd);`
+        explicit SQLlite(bool quietMode = false, bool profileMode = false, size_t cacheLimit = DEFAULT_CACHE_LIMIT, size_t memoryLimitBytes = 0, bool adaptiveMode = false)
+            : quiet(quietMode), profile(profileMode), adaptive(adaptiveMode), memoryLimit(memoryLimitBytes), cache(cacheLimit) {}
+        void processCommand(const string& cmd);
+
+        static constexpr size_t DEFAULT_CACHE_LIMIT = 16 << 20;
 
     private:
+        // counters for the command currently executing, reset per command
+        struct ExecStats{
+            size_t rowsScanned = 0;
+            size_t rowsReturned = 0;
+            size_t hashHits = 0;
+            size_t hashMisses = 0;
+            size_t bstHits = 0;
+            size_t bstMisses = 0;
+            size_t bitmapHits = 0;
+            size_t fullScans = 0;
+            size_t blocksSkipped = 0;
+            size_t compressedBlocks = 0;
+            size_t bytesSpilled = 0;
+            string accessPath;
+        };
+
+        // latency histogram per command type, bucket i holds times below 2^i us
+        struct CommandStats{
+            static constexpr size_t NUM_BUCKETS = 32;
+            uint64_t count = 0;
+            uint64_t totalMicros = 0;
+            uint64_t maxMicros = 0;
+            array<uint64_t, NUM_BUCKETS> histogram{};
+
+            void record(uint64_t micros);
+            uint64_t percentile(double p) const;
+        };
+
+        // database wide counters reported by STATS
+        struct Stats{
+            map<string, CommandStats> commands;
+            uint64_t rowsScanned = 0;
+            uint64_t rowsReturned = 0;
+            uint64_t hashHits = 0;
+            uint64_t hashMisses = 0;
+            uint64_t bstHits = 0;
+            uint64_t bstMisses = 0;
+            uint64_t bitmapHits = 0;
+            uint64_t fullScans = 0;
+            uint64_t blocksSkipped = 0;
+            uint64_t compressedBlocks = 0;
+            uint64_t bytesSpilled = 0;
+        };
+
+        enum class CompareOp { Less, Greater, Equal };
+        static CompareOp parseCompareOp(const string& op);
+
+        // (table1 row, table2 row) pairs produced by a join, kept in generation order.
+        // once the buffered pairs reach the memory limit they are appended to a temp file
+        class JoinedRows{
+            public:
+                explicit JoinedRows(size_t limit) : memoryLimit(limit) {}
+                JoinedRows(const JoinedRows&) = delete;
+                JoinedRows& operator=(const JoinedRows&) = delete;
+                ~JoinedRows();
+
+                void emplace_back(size_t row1, size_t row2);
+                size_t size() const { return count; }
+                size_t bytesSpilled() const { return spilledBytes; }
+
+                template<typename Visit>
+                void forEach(Visit visit);
+
+            private:
+                void flush();
+
+                size_t memoryLimit;
+                vector<pair<size_t, size_t>> buffer;
+                FILE* file = nullptr;
+                size_t count = 0;
+                size_t spilledBytes = 0;
+        };
+
+        // parsed JOIN <table1> AND <table2> WHERE <col1> = <col2> AND PRINT ... clause
+        struct JoinSpec{
+            string table1Name;
+            string table2Name;
+            string column1;
+            string column2;
+            int col1Index;
+            int col2Index;
+            vector<pair<string, int>> printColumnInfo; // (col name, table num)
+            vector<pair<int, int>> printColIndices; // (table num, col index)
+        };
+
+        // stored result of a JOIN, kept current as rows are inserted into or deleted from its tables
+        struct View{
+            JoinSpec spec;
+            vector<pair<size_t, size_t>> pairs; // (table1 row, table2 row) in JOIN output order
+        };
+
+        // blocked bloom filter over join keys, every key sets its bits inside one 512 bit block
+        struct BloomFilter{
+            static constexpr size_t BITS_PER_KEY = 10;
+            static constexpr size_t NUM_PROBES = 6;
+            vector<array<uint64_t, 8>> blocks;
+
+            explicit BloomFilter(size_t expectedKeys) : blocks(max<size_t>(1, (expectedKeys * BITS_PER_KEY + 511) / 512)) {}
+            void add(const Field& key);
+            bool mayContain(const Field& key) const;
+            static uint64_t mix(uint64_t h);
+        };
+
+        // roaring style compressed set of row ids. rows are split into chunks of 2^16,
+        // each stored as a sorted array while sparse and as a 1024 word bitset once dense
+        class Bitmap{
+            public:
+                static Bitmap range(size_t numRows);
+
+                void add(size_t row);
+                size_t cardinality() const;
+                size_t memory() const;
+
+                Bitmap operator&(const Bitmap& other) const { return combine(*this, other, SetOp::And); }
+                Bitmap operator|(const Bitmap& other) const { return combine(*this, other, SetOp::Or); }
+                Bitmap andNot(const Bitmap& other) const { return combine(*this, other, SetOp::AndNot); }
+
+                template<typename Visit>
+                void forEach(Visit visit) const;
+
+            private:
+                static constexpr size_t ARRAY_MAX = 4096;
+                static constexpr size_t WORDS = 1024;
+
+                enum class SetOp { And, Or, AndNot };
+
+                struct Container{
+                    size_t key; // row >> 16
+                    size_t cardinality = 0;
+                    vector<uint16_t> values; // used while cardinality <= ARRAY_MAX
+                    vector<uint64_t> words; // used otherwise
+
+                    bool isBitset() const { return !words.empty(); }
+                    void toBitset();
+                    void toArray();
+                    vector<uint64_t> asWords() const;
+                };
+
+                static Bitmap combine(const Bitmap& a, const Bitmap& b, SetOp op);
+                static Container combine(const Container& a, const Container& b, SetOp op);
+
+                vector<Container> containers; // sorted by key
+        };
+
+        // output of a PRINT or JOIN along with the table versions it was computed from
+        struct CacheEntry{
+            string output;
+            vector<pair<string, uint64_t>> dependencies;
+        };
+
+        // LRU cache of command output, keyed by the normalized command text
+        struct ResultCache{
+            size_t capacity;
+            size_t bytesUsed = 0;
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+            list<pair<string, CacheEntry>> lru; // most recently used first
+            unordered_map<string, list<pair<string, CacheEntry>>::iterator> entries;
+
+            explicit ResultCache(size_t limit) : capacity(limit) {}
+            CacheEntry* find(const string& key);
+            void insert(const string& key, CacheEntry entry);
+            void erase(const string& key);
+            static size_t entrySize(const string& key, const CacheEntry& entry);
+        };
+
+        // copies everything written to a stream into a string while still forwarding it
+        class OutputCapture : public streambuf{
+            public:
+                OutputCapture(ostream& stream, size_t limit) : os(stream), target(stream.rdbuf()), maxBytes(limit) { os.rdbuf(this); }
+                ~OutputCapture() { os.rdbuf(target); }
+                const string& captured() const { return text; }
+                bool overflowed() const { return truncated; }
+
+            protected:
+                int overflow(int ch) override;
+                streamsize xsputn(const char* s, streamsize n) override;
+                int sync() override { return target->pubsync(); }
+
+            private:
+                ostream& os;
+                streambuf* target;
+                size_t maxBytes;
+                string text;
+                bool truncated = false;
+        };
+
         struct Table{
+            // rows are grouped into fixed size blocks, each with min/max metadata per column
+            static constexpr size_t BLOCK_ROWS = 1024;
+
+            // NaN compares false against everything, so it is left out of min/max. min and max
+            // stay NaN only while every value of the block is NaN, which matches no predicate
+            struct ZoneMap{
+                Field min;
+                Field max;
+                size_t count;
+
+                explicit ZoneMap(const Field& value) : min(value), max(value), count(1) {}
+                void add(const Field& value){
+                    if(!(min == min)){
+                        min = value;
+                        max = value;
+                    }
+                    if(value < min)
+                        min = value;
+                    if(value > max)
+                        max = value;
+                    ++count;
+                }
+            };
+
             vector<string> columnNames;
             vector<ColumnType> columnTypes;
+            // rows in sealed blocks hold only their string and bool cells, at plainSlot, while
+            // their int and double cells live in segments. rows past the sealed blocks hold every cell
             vector<vector<Field>> rows;
             unordered_map<string, unordered_map<Field, vector<size_t>>> hashIndex;
             unordered_map<string, map<Field, vector<size_t>>> bstIndex;
+            unordered_map<string, map<Field, Bitmap>> bitmapIndex;
+            // adaptive index on one column: a copy of its (value, row) pairs that every range
+            // query partitions further around its bound. inserts and deletes are logged and
+            // merged in before the next query on the column. nan matches no range and is left out
+            struct CrackerColumn{
+                struct Entry{
+                    Field value;
+                    size_t row;
+                };
+
+                // splits the column into values below and values at or above the bound,
+                // or with afterEqual set, values up to and including it and values above it
+                struct Boundary{
+                    Field value;
+                    bool afterEqual;
 
-            Table(vector<string> names, vector<ColumnType> types) : columnNames(move(names)), columnTypes(move(types)) {}
+                    bool operator<(const Boundary& other) const {
+                        return value < other.value || (value == other.value && !afterEqual && other.afterEqual);
+                    }
+                    bool before(const Field& x) const { return afterEqual ? !(x > value) : x < value; }
+                };
 
+                struct Update{
+                    bool isDelete;
+                    size_t begin; // inserted rows [begin, end)
+                    size_t end;
+                    vector<size_t> rows; // deleted rows, sorted
+                };
 
-            void insertRow(const vector<Field>& row) {rows.push_back(row); }
+                vector<Entry> entries;
+                map<Boundary, size_t> pieces; // boundary -> first position not before it
+                vector<Update> pending;
+
+                size_t crack(const Boundary& bound, size_t& scanned);
+                void merge(const Table& table, size_t colIndex);
+                void rippleInsert(const Entry& entry);
+                void logInsert(size_t row);
+                size_t memory() const;
+            };
+
+            // encoded values of one sealed block of an int or double column. values are mapped to
+            // order preserving unsigned keys, so predicates compare keys without decoding to Fields
+            struct Segment{
+                enum class Codec { RunLength, FrameOfReference, Delta };
+                static constexpr size_t DELTA_STRIDE = 32;
+
+                Codec codec = Codec::RunLength;
+                size_t count = 0;
+                uint64_t base = 0; // minimum for frame of reference, first key for delta
+                unsigned bitWidth = 0;
+                vector<uint64_t> packed; // bit packed offsets or deltas
+                vector<uint64_t> anchors; // every DELTA_STRIDE-th key of a delta block
+                vector<pair<uint64_t, uint32_t>> runs; // (key, offset just past the run)
+
+                static Segment encode(const uint64_t* keys, size_t count);
+                void decode(vector<uint64_t>& keys) const;
+                uint64_t at(size_t i) const;
+                void scan(uint64_t from, uint64_t to, size_t firstRow, vector<size_t>& out) const;
+                uint64_t packedAt(size_t i) const;
+                size_t bytes() const;
+            };
+
+            vector<vector<ZoneMap>> zones; // [column][block]
+            vector<vector<Segment>> segments; // [column][sealed block], empty for string and bool columns
+            vector<vector<uint64_t>> tailKeys; // [column][row past the sealed blocks], int and double columns only
+            vector<size_t> plainSlot; // position of a string or bool cell in a sealed row
+            size_t sealedBlocks = 0;
+            unordered_map<string, CrackerColumn> crackers;
+            uint64_t version = 0;
+
+            Table(vector<string> names, vector<ColumnType> types);
+
+
+            void insertRow(const vector<Field>& row, const vector<uint64_t>& keys);
+            void eraseRows(const vector<size_t>& rowIds);
+            void rebuildZones(size_t firstBlock);
+            void sealBlock();
+            bool isEncoded(size_t colIndex) const { return columnTypes[colIndex] == ColumnType::Int || columnTypes[colIndex] == ColumnType::Double; }
+            size_t sealedRows() const { return sealedBlocks * BLOCK_ROWS; }
+            const Field& cell(size_t row, size_t colIndex, optional<Field>& scratch) const;
+            uint64_t key(size_t row, size_t colIndex) const;
+            static uint64_t intKey(int value);
+            static uint64_t doubleKey(double value);
+            static Field decodeKey(uint64_t key, ColumnType type);
+            static void keyInterval(ColumnType type, CompareOp op, const Field& val, uint64_t& from, uint64_t& to);
+            static void equalKeys(ColumnType type, uint64_t key, uint64_t& from, uint64_t& to);
+            bool blockMayMatch(size_t colIndex, size_t block, CompareOp op, const Field& val) const;
+            void matchRows(size_t colIndex, CompareOp op, const Field& val, uint64_t from, uint64_t to, vector<size_t>& out, ExecStats& exec) const;
+            vector<size_t> scanWhere(size_t colIndex, CompareOp op, const Field& val, ExecStats& exec) const;
+            vector<size_t> crackWhere(size_t colIndex, CompareOp op, const Field& val, ExecStats& exec);
+            bool hasIndex(const string& col) const;
+            vector<size_t> lookupEqual(size_t colIndex, const Field& key, ExecStats& exec) const;
             void printAll();
 
-            void printWhere(const vector<string>& selectedColumns, const string& whereCol, const string& op, const Field& val, bool quiet, const string& tableName);
+            void printWhere(const vector<string>& selectedColumns, const string& whereCol, const string& op, const Field& val, bool quiet, bool adaptive, const string& tableName, ExecStats& exec);
             void deleteWhere(const string& col, const string& op, const Field& val);
             void generateIndex(const string& col, const string& type, const string& tableName);
+            size_t rowMemory() const;
+            size_t segmentMemory() const;
+            BloomFilter buildBloom(size_t colIndex) const;
+            vector<size_t> bloomScan(size_t colIndex, const BloomFilter& filter) const;
+            Bitmap bitmapWhere(const string& col, CompareOp op, const Field& val) const;
 
-            struct RowMatch{
-                size_t colIndex;
-                string op;
-                Field val;
-
-                RowMatch(size_t idx, string operation, Field value) : colIndex(idx), op(move(operation)), val(move(value)) {}
-                bool operator()(const vector<Field>& row) const {
-                    if(op == "<")
-                        return row[colIndex] < val;
-                    else if(op == ">")
-                        return row[colIndex] > val;
-                    else if(op == "=")
-                        return row[colIndex] == val;
-                    return false;
+            // comparison is fixed at compile time so matching a value is a single Field compare.
+            // string and bool values are only reachable through Field, so their scans use this
+            template<CompareOp Op>
+            struct ValueMatch{
+                const Field& val;
+
+                bool operator()(const Field& value) const {
+                    if constexpr (Op == CompareOp::Less)
+                        return value < val;
+                    else if constexpr (Op == CompareOp::Greater)
+                        return value > val;
+                    else
+                        return value == val;
                 }
             };
+
+            // string and bool scan loop instantiated once per comparison, picked per query through the
+            // kernel table. slot is the cell's position within the scanned rows
+            using ScanKernel = void (*)(const vector<vector<Field>>& rows, size_t slot, const Field& val, size_t begin, size_t end, vector<size_t>& out);
+
+            template<CompareOp Op>
+            static void scanKernel(const vector<vector<Field>>& rows, size_t slot, const Field& val, size_t begin, size_t end, vector<size_t>& out);
+            static ScanKernel scanKernelFor(CompareOp op);
+
+            // int and double scan loop over plain keys. the comparison is folded into [from, to],
+            // so one loop serves every operator
+            static void keyScanKernel(const uint64_t* keys, size_t count, uint64_t from, uint64_t to, size_t firstRow, vector<size_t>& out);
         };
 
         unordered_map<string, Table> tables;
+        unordered_map<string, View> views;
         bool quiet;
+        bool profile;
+        bool adaptive; // crack unindexed columns on range queries
+        size_t memoryLimit; // 0 means unlimited
+        Stats stats;
+        ExecStats current;
+        ResultCache cache;
+        uint64_t versionClock = 0;
+
+        void executeCommand(const string& cmd, const vector<string>& tokens);
+        void executeCached(const string& cmd, const vector<string>& tokens);
+        void bumpVersion(Table& table) { table.version = ++versionClock; }
+        void recordCommand(const string& cmd, uint64_t micros);
+        void printStats();
+        void printCompression(const vector<string>& tokens);
         void createTable(const vector<string>& tokens);
         void removeTable(const string& tableName);
         void insertInto(const vector<string>& tokens);
         void printTable(const vector<string>& tokens, bool quiet);
         void deleteFromTable(const vector<string>& tokens);
         void joinTables(const vector<string>& tokens);
+        bool parseJoin(const vector<string>& tokens, JoinSpec& spec);
+        void computeJoin(const JoinSpec& spec, JoinedRows& joinedRows);
+        void createView(const vector<string>& tokens);
+        void printView(const string& viewName);
+        void updateViewsAfterInsert(const string& tableName, size_t startIndex);
+        void updateViewsAfterDelete(const string& tableName, const vector<size_t>& deletedRows);
         void generateIndex(const vector<string>& tokens);
         Field parseValue(const string& value, ColumnType type);
 };
\ No newline at end of file